@@ -0,0 +1,211 @@
+// C++ Includes
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ROOT Includes
+#include <TString.h>
+
+// Project Includes
+#include "CAConfiguration.hpp"
+#include "CAGainCorrection.hpp"
+#include "CAHistogramSpec.hpp"
+#include "CAUtilities.hpp"
+#include "TCAChannel.hpp"
+#include "TCADAQModule.hpp"
+#include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+#include "TCAExperiment.hpp"
+#include "TCAFlatHistogram.hpp"
+#include "TCAHistogram.hpp"
+#include "TCARunSorter.hpp"
+
+static constexpr int kAmplitudeBins = 8192;      // Bins of the per-channel amplitude spectra
+static constexpr double kAmplitudeMax = 65536.0; // MDPP-16 amplitudes are 16 bit
+static constexpr int kMaxMultiplicity = 16;      // Hits per module and event shown in the multiplicity spectra
+
+typedef std::vector<std::vector<CAGainCorrection::Coefficients>> GainShifts; // Per module and channel
+
+static void AddChannelHistograms(TCAExperiment& experiment, const GainShifts& gainShifts)
+{
+    for (size_t moduleIdx = 0; moduleIdx < experiment.GetModuleCount(); moduleIdx++)
+    {
+        auto module = experiment.GetModule(moduleIdx);
+        const size_t moduleID = module->GetModuleID();
+        for (size_t ch = 0; ch < module->GetChannelCount(); ch++)
+        {
+            auto channel = module->GetChannel(ch);
+
+            // One spectrum per channel fills every event, so its fill functions are inlined rather than called through std::function
+            channel->AddStaticHistogram<TCAFlatH1I>(
+                [moduleID, ch](TCAFlatH1I& hist, TCAEvent* event)
+                {
+                    const double amplitude = (*event)(moduleID, TCAEvent::kAmplitude, ch);
+                    if (amplitude > 0) // Empty channels are exported as NaN or 0
+                        hist.Fill(amplitude);
+                },
+                [moduleID, ch](TCAFlatH1I& hist, const TCAEventBlock& block)
+                {
+                    const auto amplitudes = block.View(moduleID, TCAEvent::kAmplitude);
+                    for (size_t entry = 0; entry < amplitudes.GetEntries(); entry++)
+                    {
+                        const double amplitude = amplitudes(entry, ch);
+                        if (amplitude > 0)
+                            hist.Fill(amplitude);
+                    }
+                },
+                {{moduleID, TCAEvent::kAmplitude}}, Form("%s_raw", channel->GetName()), Form("%s Raw Amplitude;Amplitude (a.u.);Counts", channel->GetTitle()), kAmplitudeBins, 0.0, kAmplitudeMax);
+
+            if (moduleID >= gainShifts.size() || ch >= gainShifts[moduleID].size())
+                continue;
+
+            auto gainShift = gainShifts[moduleID][ch];
+            channel->AddStaticHistogram<TCAFlatH1I>(
+                [moduleID, ch, gainShift](TCAFlatH1I& hist, TCAEvent* event)
+                {
+                    const double amplitude = (*event)(moduleID, TCAEvent::kAmplitude, ch);
+                    if (amplitude > 0)
+                        hist.Fill(gainShift(amplitude));
+                },
+                nullptr, {{moduleID, TCAEvent::kAmplitude}}, Form("%s_gs", channel->GetName()), Form("%s Gain-Matched Amplitude;Amplitude (a.u.);Counts", channel->GetTitle()), kAmplitudeBins, 0.0, kAmplitudeMax);
+        }
+    }
+}
+
+static void AddModuleHistograms(TCAExperiment& experiment)
+{
+    // Multiplicities come from the per-event hit lists, so they cost one pass over the hits rather than over every channel
+    experiment.SetBuildHits(true);
+    for (size_t moduleIdx = 0; moduleIdx < experiment.GetModuleCount(); moduleIdx++)
+    {
+        auto module = experiment.GetModule(moduleIdx);
+        const size_t moduleID = module->GetModuleID();
+        auto multHist = module->AddHistogram<TCAHistogram<TCAFlatH1I>>(Form("%s_mult", module->GetName()), Form("%s Hit Multiplicity;Hits per Event;Counts", module->GetTitle()), kMaxMultiplicity + 1, -0.5, kMaxMultiplicity + 0.5);
+        multHist->SetBlockFillFunction([moduleID](std::shared_ptr<TCAFlatH1I> hist, const TCAEventBlock& block)
+                                       {
+            if (!block.HasHits())
+                return;
+            for (size_t entry = 0; entry < block.GetEntries(); entry++)
+            {
+                int multiplicity = 0;
+                for (const auto& hit : block.Hits(entry))
+                    multiplicity += hit.fModuleID == moduleID;
+                hist->Fill(multiplicity);
+            } }, {{moduleID, TCAEvent::kAmplitude}});
+    }
+}
+
+static GainShifts LoadGainShifts(const std::string& fileName)
+{
+    try
+    {
+        return CAGainCorrection::ReadCoefficients(fileName);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        std::cerr << "[WARN] No gain shift data available, gain-matched spectra will not be sorted." << std::endl;
+    }
+    return GainShifts();
+}
+
+static TCAEventBlock::PileUpPolicy GetPileUpPolicy(const std::string& name)
+{
+    if (name == "keep")
+        return TCAEventBlock::kKeepPileUp;
+    if (name == "tag")
+        return TCAEventBlock::kTagPileUp;
+    if (name == "reject")
+        return TCAEventBlock::kRejectPileUp;
+    throw std::runtime_error("[ERROR] Unknown pile-up policy " + name + ", use keep, tag or reject");
+}
+
+// Entry index of a run, next to the run when only a selection is given
+static std::string GetEntryIndexFileName(const CAUtilities::Args& args, const std::string& runFileName, int runNumber)
+{
+    if (!args.entryIndexFileName.empty())
+        return runNumber < 0 ? args.entryIndexFileName : CAUtilities::GetRunFileName(args.entryIndexFileName, runNumber);
+    return args.selection.empty() ? std::string() : runFileName + ENTRY_INDEX_EXTENSION;
+}
+
+// Snapshot file next to the output, out.root snapshots to out.snapshot.root
+static std::string GetSnapshotFileName(const std::string& outputFileName)
+{
+    const std::string extension = ".root";
+    if (outputFileName.size() > extension.size() && outputFileName.compare(outputFileName.size() - extension.size(), extension.size(), extension) == 0)
+        return outputFileName.substr(0, outputFileName.size() - extension.size()) + SNAPSHOT_EXTENSION;
+    return outputFileName + SNAPSHOT_EXTENSION;
+}
+
+static std::unique_ptr<TCAExperiment> MakeExperiment(const CAUtilities::Args& args, const std::vector<CAHistogramSpec::FamilySpec>& specs, const GainShifts& gainShifts, const std::string& hitCacheFileName, const std::string& entryIndexFileName, const std::string& outputFileName)
+{
+    auto experiment = std::make_unique<TCAExperiment>("CASort", "Clover Array Sort");
+    experiment->BuildDetectorTree();
+    experiment->SetBlockSize(args.blockSize);
+    experiment->SetNIOThreads(args.ioThreads);
+    experiment->SetPrefetchDepth(args.prefetchDepth);
+    experiment->SetFillBufferSize(args.fillBufferSize);
+    experiment->SetCoincidenceWindow(args.coincidenceWindow);
+    experiment->SetPileUpPolicy(GetPileUpPolicy(args.pileUpPolicy));
+    experiment->SetHitCacheFile(hitCacheFileName);
+    experiment->SetEntryIndexFile(entryIndexFileName);
+    experiment->SetSnapshots(GetSnapshotFileName(outputFileName), args.snapshotInterval, args.snapshotEntries);
+    if (!args.selection.empty())
+        experiment->SetSelection(args.selection);
+    if (specs.empty())
+        AddChannelHistograms(*experiment, gainShifts);
+    else
+        CAHistogramSpec::Expand(*experiment, specs, gainShifts);
+    if (args.multiplicity)
+        AddModuleHistograms(*experiment); // Hit lists need every module's amplitude, time and pile-up columns
+    return experiment;
+}
+
+int main(int argc, char* argv[])
+{
+    try
+    {
+        const auto args = CAUtilities::ParseArguments(argc, argv);
+        CAUtilities::PrintConfiguration(args);
+
+        const auto specs = args.specFileName.empty() ? std::vector<CAHistogramSpec::FamilySpec>() : CAHistogramSpec::ReadSpecFile(args.specFileName);
+        if (!args.runNumbers.empty())
+        {
+            // A gain shift file name with a printf pattern holds one table per run, a plain file is shared by all runs
+            const bool perRunGainShifts = args.gainShiftFile.find('%') != std::string::npos;
+            const GainShifts sharedGainShifts = perRunGainShifts ? GainShifts() : LoadGainShifts(args.gainShiftFile);
+
+            TCARunSorter sorter(args.runNumbers, [&](int runNumber)
+                                {
+                const auto gainShifts = perRunGainShifts ? LoadGainShifts(Form(args.gainShiftFile.c_str(), runNumber)) : sharedGainShifts;
+                const auto hitCacheFileName = args.hitCacheFileName.empty() ? std::string() : CAUtilities::GetRunFileName(args.hitCacheFileName, runNumber);
+                const auto entryIndexFileName = GetEntryIndexFileName(args, CAUtilities::GetRunFileName(args.runFileName, runNumber), runNumber);
+                const auto outputFileName = CAUtilities::GetRunFileName(args.outputFileName, runNumber); // Snapshots are per run, also when summing
+                return MakeExperiment(args, specs, gainShifts, hitCacheFileName, entryIndexFileName, outputFileName); });
+            sorter.SetRunFileName(args.runFileName);
+            sorter.SetOutputFileName(args.outputFileName);
+            sorter.SetSumRuns(args.sumRuns);
+            sorter.SetConcurrentRuns(args.concurrentRuns);
+            return sorter.Sort() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        auto experiment = MakeExperiment(args, specs, LoadGainShifts(args.gainShiftFile), args.hitCacheFileName, GetEntryIndexFileName(args, args.runFileName, -1), args.outputFileName);
+#if DEBUG >= 2
+        experiment->PrintInfo();
+#endif
+
+        experiment->OpenRun(args.runFileName);
+        experiment->Sort();
+        experiment->WriteOutput(args.outputFileName);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
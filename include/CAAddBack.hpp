@@ -3,6 +3,8 @@
 
 // C++ Includes
 #include <array>
+#include <cstddef>
+#include <vector>
 
 // ROOT Includes
 
@@ -16,6 +18,21 @@ namespace CAAddBack
 
     double GetAddBackEnergy(std::array<double, 4> xtalE, std::array<double, 4> xtalT);
 
+    // One gamma per clover that fired, filled into a gamma-gamma matrix or cube (TCASymmetricH2/H3) once per unordered pair or triple
+    template <typename H>
+    void FillCoincidences(H& hist, const std::vector<std::array<double, 4>>& cloverE, const std::vector<std::array<double, 4>>& cloverT)
+    {
+        thread_local std::vector<double> energies;
+        energies.clear();
+        for (size_t clover = 0; clover < cloverE.size(); clover++)
+        {
+            const double energy = GetAddBackEnergy(cloverE[clover], cloverT[clover]);
+            if (energy > 0)
+                energies.push_back(energy);
+        }
+        hist.FillCoincidences(energies.data(), energies.size());
+    }
+
 } // namespace CAAddBack
 
 #endif // CAADDBACK_HPP
\ No newline at end of file
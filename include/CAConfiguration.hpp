@@ -3,6 +3,7 @@
 
 // C++ Includes
 #include <algorithm>
+#include <array>
 #include <thread>
 
 // Which modules to process
@@ -12,10 +13,46 @@
 // Number of hardware threads to use in processing
 const unsigned int kMaxThreads = std::min(20U, std::thread::hardware_concurrency()); // Number of threads to use for processing, defaults to system max
 
+// Number of entries read at once into an event block, 0 reads entry by entry
+const size_t kDefaultBlockSize = 4096;
+
+// Read-ahead stage, I/O threads read and decompress event blocks into a queue of this many blocks, 0 threads reads inline
+const unsigned int kDefaultIOThreads = 0;
+const size_t kDefaultPrefetchDepth = 16;
+
+// Coincidence window of the event builder for free-running modules, in module timestamp ticks, negative reads events as stored
+const double kDefaultCoincidenceWindow = -1.0;
+
+// Fills buffered per worker thread before they are applied histogram by histogram, 0 fills directly
+const size_t kDefaultFillBufferSize = 0;
+
+// Channels with a raw amplitude above this enter the per-event hit lists, empty channels read as NaN or 0
+const double kDefaultHitThreshold = 0.0;
+
 // Debug Mode
 #define DEBUG 1
 
+// DAQ Module Layout, indexed by module ID
+inline constexpr std::array<const char*, 4> kModuleNames = {"clover_cross", "clover_back", "cebr_all", "pos_sig"}; // Module names as exported by MVME
+inline constexpr std::array<const char*, 4> kModuleTypes = {"MDPP16SCP", "MDPP16SCP", "MDPP16QDC", "MDPP16SCP"};   // Module firmware types
+inline constexpr std::array<size_t, 4> kChannelsPerDetector = {4, 4, 1, 1};                                      // Channels grouped into one detector (4 crystals per clover)
+inline constexpr std::array<bool, 4> kProcessModule = {true, true, PROCESS_CEBR_ALL, PROCESS_POS_SIG};           // Modules which are sorted
+inline constexpr std::array<char, 4> kModuleClasses = {'g', 'g', 'c', 'p'};                                       // Detector class in entry index selections (--select=gg)
+
+// Run Tree Layout
+#define RUN_TREE_NAME "event0"       // Name of the event tree in the run file
+#define BRANCH_NAME_TEMPLATE "%s.%s" // Branch name from module name and filter name
+
+// Runs given as MVME listfiles are decoded directly instead of read from a run tree
+#define LISTFILE_EXTENSION ".mvmelst"
+
+// Entry indices of multiplicity classes are written next to the run unless a path is given
+#define ENTRY_INDEX_EXTENSION ".caidx"
+
+// Snapshots written during a sort replace the .root extension of the output file
+#define SNAPSHOT_EXTENSION ".snapshot.root"
+
 // Calibration File Name Templates
 #define RUN_FILE_NAME_TEMPLATE "root_data_70Ge_run%03d.mvmelst.bin_tree.root"
 
-#endif // CACONFIGURATION_HPP
\ No newline at end of file
+#endif // CACONFIGURATION_HPP
@@ -2,6 +2,9 @@
 #define CACROSSTALKCORRECTION_HPP
 
 // C++ Includes
+#include <array>
+#include <cmath>
+#include <memory>
 #include <vector>
 
 // ROOT Includes
@@ -10,6 +13,7 @@
 #include <TMatrixD.h>
 
 // Project Includes
+#include "CAAddBack.hpp"
 #include "TCAHistogram.hpp"
 
 namespace CACrosstalkCorrection
@@ -46,7 +50,20 @@ namespace CACrosstalkCorrection
     // Function used to model crosstalk effect
     double CrosstalkFitFunction(double* x, double* par);
 
-    void FillXTalkHistograms(const std::array<std::shared_ptr<TH2D>, 6>& xtalkPairHists, const std::array<double, 4>& xtalE, std::array<double, 4>& xtalT);
+    // H is TH2D or, to keep 20 per-thread replicas of the 6 matrices per clover affordable, the sparse TCATiledH2I or TCATiledH2C
+    template <typename H>
+    void FillXTalkHistograms(const std::array<std::shared_ptr<H>, 6>& xtalkPairHists, const std::array<double, 4>& xtalE, std::array<double, 4>& xtalT)
+    {
+        static constexpr std::array<std::pair<short, short>, 6> xtalPairs = {{{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}}};
+        for (size_t i = 0; i < xtalPairs.size(); i++)
+        {
+            auto [xtalX, xtalY] = xtalPairs[i];
+            if ((xtalE[xtalX] > CAAddBack::kAddBackThreshold) && (xtalE[xtalY] > CAAddBack::kAddBackThreshold) && (fabs(xtalT[xtalX] - xtalT[xtalY]) < CAAddBack::kAddBackWindow))
+            {
+                xtalkPairHists[i]->Fill(xtalE[xtalX], xtalE[xtalY]);
+            }
+        }
+    }
 
     std::shared_ptr<TGraphErrors> BuildCrosstalkGraph(const TH2D* hist);
 
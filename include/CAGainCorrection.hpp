@@ -15,6 +15,16 @@ namespace CAGainCorrection
 
     inline std::string gGainCorrectionDir = "";
 
+    // Linear gain shift of one channel, gain * x + offset
+    struct Coefficients
+    {
+        double offset = 0.0;
+        double gain = 1.0;
+
+        inline double operator()(double x) const { return gain * x + offset; }
+    };
+
+    std::vector<std::vector<Coefficients>> ReadCoefficients(const std::string& fileName); // Per module and channel
     std::vector<std::vector<std::function<double(double)>>> MakeCorrections(const std::string& fileName);
 
 } // namespace CAGainCorrection
@@ -0,0 +1,63 @@
+#ifndef CAHISTOGRAMSPEC_HPP
+#define CAHISTOGRAMSPEC_HPP
+
+// C++ Includes
+#include <string>
+#include <vector>
+
+// ROOT Includes
+
+// Project Includes
+#include "CAGainCorrection.hpp"
+#include "TCAEvent.hpp"
+
+// Forward declarations
+class TCAExperiment;
+
+// Histogram specification files list families of per-channel or per-detector spectra, one family per line:
+//
+//   # name  type  owner     source        stage  bins  min  max    classes
+//   raw     H1I   channel   amplitude     raw    8192  0    65536  all
+//   gs      H1I   channel   amplitude     gain   8192  0    65536  g
+//   time    H1F   channel   channel_time  raw    4096  0    65536  gc
+//   sum     H1I   detector  amplitude     gain   8192  0    65536  g
+//
+// type is H1I, H1F or H1D (TCAFlatH1I, ...), owner is channel or detector (one spectrum summing the detector's
+// channels), source is a filter of TCAEvent::kFilterNames, stage is raw or gain (shifted by the gain shift file) and
+// classes are letters of kModuleClasses or all. Lines starting with # are comments.
+namespace CAHistogramSpec
+{
+    enum Owner
+    {
+        kChannel,
+        kDetector
+    };
+
+    enum Stage
+    {
+        kRaw,
+        kGain
+    };
+
+    struct FamilySpec
+    {
+        std::string name; // Histograms are named <owner>_<name>
+        std::string type;
+        Owner owner = kChannel;
+        TCAEvent::FilterID filterID = TCAEvent::kAmplitude;
+        Stage stage = kRaw;
+        int nBins = 0;
+        double min = 0.0;
+        double max = 0.0;
+        std::string classes; // Detector classes covered, "all" for every module
+    };
+
+    std::vector<FamilySpec> ReadSpecFile(const std::string& fileName);
+
+    // Adds one TCAHistogramFamily per spec to the experiment and its members to the channels and detectors, returns the
+    // number of histograms added. Gain-shifted families skip channels without coefficients
+    size_t Expand(TCAExperiment& experiment, const std::vector<FamilySpec>& specs, const std::vector<std::vector<CAGainCorrection::Coefficients>>& gainShifts);
+
+} // namespace CAHistogramSpec
+
+#endif // CAHISTOGRAMSPEC_HPP
@@ -3,6 +3,8 @@
 
 // C++ Includes
 #include <atomic>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -18,15 +20,52 @@ namespace CAUtilities
         std::string gainShiftFile;
         std::string runFileName;
         std::string outputFileName;
+        std::string hitCacheFileName;
+        std::string specFileName;       // Histogram specification file, empty for the built-in spectra
+        std::string entryIndexFileName; // Entry index written during the sort, or read for --select
+        std::string selection;          // Coincidence class to sort, e.g. gg, empty for all entries
         int runNumber;
+        size_t blockSize;
+        unsigned int ioThreads;
+        size_t prefetchDepth;
+        size_t fillBufferSize;
+        double coincidenceWindow;
+        std::string pileUpPolicy; // keep, tag or reject
+        double snapshotInterval;  // Seconds between snapshots during the sort, 0 for none
+        uint64_t snapshotEntries; // Entries between snapshots during the sort, 0 for none
+        std::vector<int> runNumbers; // Runs sorted with --runs, runFileName is then a pattern or directory, see GetRunFileName()
+        bool sumRuns;                // Write one summed output instead of one output per run
+        unsigned int concurrentRuns; // Runs sorted side by side with --runs
+        bool multiplicity;           // Build hit lists and sort the module hit multiplicity spectra
     };
 
     Args ParseArguments(int argc, char* argv[]);
 
     void PrintConfiguration(const Args& args);
 
+    std::vector<int> ParseRunList(const std::string& runList); // "12-87" or "12,14,20-25"
+
+    // Per-run file name: printf patterns get the run number, directories get RUN_FILE_NAME_TEMPLATE and
+    // anything else gets _run<number> before its extension
+    std::string GetRunFileName(const std::string& name, int runNumber);
+
     void DisplayProgressBar(std::atomic<uint64_t>& processedEntries, uint64_t totalEntries);
 
+    // Calls func(i) for i in [0, n) on up to nThreads threads, rethrows the first exception once all threads are done
+    void ParallelFor(size_t n, unsigned int nThreads, const std::function<void(size_t)>& func);
+
+    // Pairwise reduction of objects into objects[0] with Add(), log2(n) rounds of independent adds run side by side
+    template <typename T>
+    void TreeReduce(const std::vector<T*>& objects, unsigned int nThreads)
+    {
+        for (size_t stride = 1; stride < objects.size(); stride *= 2)
+        {
+            const size_t nPairs = (objects.size() - stride + 2 * stride - 1) / (2 * stride);
+            ParallelFor(nPairs, nThreads, [&objects, stride](size_t pair)
+                        { objects[pair * 2 * stride]->Add(objects[pair * 2 * stride + stride]); });
+        }
+    }
+
     std::vector<std::vector<std::vector<double>>> ReadCAFile(const std::string& fileName);
 
 } // namespace CAUtilities
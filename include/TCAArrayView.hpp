@@ -0,0 +1,30 @@
+#ifndef TCAARRAYVIEW_HPP
+#define TCAARRAYVIEW_HPP
+
+// Standard C++ includes
+#include <cstddef>
+
+// ROOT includes
+
+// Project includes
+
+// Contiguous, read-only view of doubles, in the spirit of std::span
+class TCAArrayView
+{
+public:
+    TCAArrayView() = default;
+    TCAArrayView(const double* data, size_t size) : fData(data), fSize(size) {}
+
+    inline const double* data() const { return fData; }
+    inline size_t size() const { return fSize; }
+    inline bool empty() const { return fSize == 0; }
+    inline const double* begin() const { return fData; }
+    inline const double* end() const { return fData + fSize; }
+    inline double operator[](size_t idx) const { return fData[idx]; }
+
+private:
+    const double* fData = nullptr;
+    size_t fSize = 0;
+};
+
+#endif // TCAARRAYVIEW_HPP
@@ -0,0 +1,70 @@
+#ifndef TCABOUNDEDQUEUE_HPP
+#define TCABOUNDEDQUEUE_HPP
+
+// Standard C++ includes
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// ROOT includes
+
+// Project includes
+
+// Blocking multi-producer, multi-consumer queue holding at most a fixed number of items. Push() waits while the queue is full,
+// Pop() waits while it is empty, and Close() releases everyone: pushes then fail and pops drain what is left.
+template <typename T>
+class TCABoundedQueue
+{
+public:
+    // Constructors
+    TCABoundedQueue() = delete;
+    TCABoundedQueue(const TCABoundedQueue&) = delete;
+    explicit TCABoundedQueue(size_t capacity) : fCapacity(std::max<size_t>(1, capacity)) {}
+
+    // Getters
+    inline size_t GetCapacity() const { return fCapacity; }
+
+    // Methods
+    bool Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(fMutex);
+        fNotFull.wait(lock, [this] { return fItems.size() < fCapacity || fClosed; });
+        if (fClosed)
+            return false;
+        fItems.push_back(std::move(item));
+        fNotEmpty.notify_one();
+        return true;
+    }
+
+    bool Pop(T& item) // False once the queue is closed and empty
+    {
+        std::unique_lock<std::mutex> lock(fMutex);
+        fNotEmpty.wait(lock, [this] { return !fItems.empty() || fClosed; });
+        if (fItems.empty())
+            return false;
+        item = std::move(fItems.front());
+        fItems.pop_front();
+        fNotFull.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fClosed = true;
+        fNotFull.notify_all();
+        fNotEmpty.notify_all();
+    }
+
+private:
+    const size_t fCapacity;
+    std::mutex fMutex;
+    std::condition_variable fNotFull;
+    std::condition_variable fNotEmpty;
+    std::deque<T> fItems;
+    bool fClosed = false;
+};
+
+#endif // TCABOUNDEDQUEUE_HPP
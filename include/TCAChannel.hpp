@@ -2,6 +2,7 @@
 #define TCACHANNEL_HPP
 
 // Standard C++ includes
+#include <string>
 
 // ROOT includes
 
@@ -20,6 +21,7 @@ public:
 
     // Getters
     inline size_t GetChannelID() const { return fChannelID; }
+    inline const char* GetType() const { return fType.c_str(); }
 
     // Setters
 
@@ -29,6 +31,7 @@ public:
 protected:
     inline static size_t fgChannelIDCounter = 0; // Static counter to assign unique IDs
     const size_t fChannelID;                     // Unique ID for the channel
+    std::string fType;                           // Type of signal on this channel (e.g. "MDPP16SCP")
 };
 
 #endif // TCACHANNEL_HPP
@@ -2,6 +2,8 @@
 #define TCADAQMODULE_HPP
 
 // Standard C++ includes
+#include <memory>
+#include <string>
 #include <vector>
 
 // ROOT includes
@@ -10,11 +12,14 @@
 #include "TCAHistogramOwner.hpp"
 
 // Forward declarations
+class TCAChannel;
 class TCADetector;
 
 class TCADAQModule : public TCAHistogramOwner
 {
 public:
+    static inline constexpr size_t kMDPP16Channels = 16; // Channels per MDPP-16 module
+
     // Constructor
     TCADAQModule();
     TCADAQModule(const char* name, const char* title, const char* type);
@@ -25,19 +30,26 @@ public:
     // Getters
     inline size_t GetModuleID() const { return fModuleID; }
     inline const char* GetType() const { return fType.c_str(); }
+    inline size_t GetChannelCount() const { return fChannelCount; }
+    inline TCAChannel* GetChannel(size_t channel) const { return fChannels.at(channel).get(); }
+    inline size_t GetDetectorCount() const { return fDetectors.size(); }
+    inline TCADetector* GetDetector(size_t detector) const { return fDetectors.at(detector).get(); }
 
     // Setters
+    inline void SetModuleID(size_t moduleID) { fModuleID = moduleID; }
 
     // Methods
+    TCADetector* AddDetector(const char* name, const char* title);
     virtual void PrintInfo() const;
 
 protected:
     inline static size_t fgModuleIDCounter = 0; // Static counter to assign unique module IDs
 
-    std::string fType;                   // Type of DAQ module (e.g. "MDPP16SCP")
-    size_t fModuleID;                    // Unique ID for this DAQ module
-    const size_t fChannelCount;          // Number of channels in this DAQ module
-    std::vector<TCADetector> fDetectors; // Detectors associated with this DAQ module
+    std::string fType;                                     // Type of DAQ module (e.g. "MDPP16SCP")
+    size_t fModuleID;                                      // Unique ID for this DAQ module
+    const size_t fChannelCount;                            // Number of channels in this DAQ module
+    std::vector<std::unique_ptr<TCAChannel>> fChannels;    // Channels of this DAQ module
+    std::vector<std::unique_ptr<TCADetector>> fDetectors; // Detectors associated with this DAQ module
 };
 
 #endif // TCADAQMODULE_HPP
\ No newline at end of file
@@ -2,12 +2,16 @@
 #define TCADETECTOR_HPP
 
 // Standard C++ includes
+#include <vector>
 
 // ROOT includes
 
 // Project includes
 #include "TCAHistogramOwner.hpp"
 
+// Forward declarations
+class TCAChannel;
+
 class TCADetector : public TCAHistogramOwner
 {
 public:
@@ -20,15 +24,19 @@ public:
     virtual ~TCADetector();
 
     // Getters
+    inline size_t GetDetectorID() const { return fDetectorID; }
+    inline const std::vector<TCAChannel*>& GetChannels() const { return fChannels; }
 
     // Setters
 
     // Methods
+    inline void AddChannel(TCAChannel* channel) { fChannels.push_back(channel); }
     virtual void PrintInfo() const;
 
 protected:
     inline static size_t fgDetectorIDCounter = 0; // Static counter to assign unique IDs
     size_t fDetectorID;                           // Unique ID for the detector
+    std::vector<TCAChannel*> fChannels;           // Channels read out by this detector, owned by their DAQ module
 };
 
 #endif // TCADETECTOR_HPP
\ No newline at end of file
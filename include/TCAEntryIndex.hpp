@@ -0,0 +1,78 @@
+#ifndef TCAENTRYINDEX_HPP
+#define TCAENTRYINDEX_HPP
+
+// Standard C++ includes
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ROOT includes
+#include <RtypesCore.h>
+
+// Project includes
+#include "TCAEventBlock.hpp"
+#include "TCAHitCache.hpp"
+
+// Side index of a run written during a full sort: one byte per entry holding the hit multiplicity of each detector
+// class. Later sorts gated on a coincidence class (--select=gg) only read the spans of entries that pass the gate.
+namespace CAEntryIndex
+{
+    static constexpr char kMagic[4] = {'C', 'A', 'E', 'I'};
+    static constexpr uint32_t kVersion = 1;
+
+    struct FileHeader
+    {
+        char fMagic[4];
+        uint32_t fVersion;
+        uint64_t fEntries;                                  // Entries in the index, one byte each after the header
+        char fSourceName[CAHitCache::kSourceNameLength];    // Base name of the run the index was made from
+    };
+
+} // namespace CAEntryIndex
+
+class TCAEntryIndex
+{
+public:
+    typedef std::pair<Long64_t, Long64_t> EntryRange;
+
+    // Detector classes counted per entry, named by the letters of kModuleClasses
+    enum DetectorClass
+    {
+        kGamma = 0,  // Clover crystals
+        kCeBr = 1,   // CeBr detectors
+        kPosSig = 2, // Position signals
+        kNClasses = 3
+    };
+
+    static inline constexpr std::array<char, kNClasses> kClassLetters = {'g', 'c', 'p'};
+    static inline constexpr std::array<unsigned int, kNClasses> kClassShift = {0, 4, 6}; // Bit offset of each class in the entry byte
+    static inline constexpr std::array<unsigned int, kNClasses> kClassMax = {15, 3, 3};  // Multiplicities saturate here
+
+    typedef std::array<uint8_t, kNClasses> Selection; // Smallest multiplicity of each class an entry needs to be selected
+
+    // Constructors
+    TCAEntryIndex(Long64_t entries, const std::string& runFileName); // Empty index, filled block by block during a sort
+    explicit TCAEntryIndex(const std::string& fileName);             // Index written by an earlier sort
+
+    // Getters
+    inline Long64_t GetEntries() const { return static_cast<Long64_t>(fClasses.size()); }
+    inline const char* GetSourceName() const { return fSourceName.c_str(); }
+    inline unsigned int GetMultiplicity(Long64_t entry, DetectorClass detectorClass) const { return fClasses[entry] >> kClassShift[detectorClass] & kClassMax[detectorClass]; }
+    bool Matches(Long64_t entry, const Selection& selection) const;
+    Long64_t CountSelected(const Selection& selection) const;
+    std::vector<EntryRange> GetSelectedRanges(const Selection& selection, Long64_t maxGap) const; // Spans of selected entries, bridging gaps of up to maxGap entries
+
+    // Methods
+    void Fill(const TCAEventBlock& block); // Record the entries of a block with flags, entries of different blocks may be filled from any thread
+    void Write(const std::string& fileName) const;
+
+    static Selection ParseSelection(const std::string& selection); // One letter per detector, "gg" is two clover crystals, "gc" a crystal and a CeBr
+
+private:
+    std::string fSourceName;
+    std::vector<uint8_t> fClasses; // Packed multiplicities of each entry
+};
+
+#endif // TCAENTRYINDEX_HPP
@@ -3,14 +3,24 @@
 
 // Standard C++ includes
 #include <array>
+#include <bitset>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
 
 // ROOT includes
+#include <TString.h>
+#include <TTreeReader.h>
 #include <TTreeReaderArray.h>
 
 // Project includes
+#include "CAConfiguration.hpp"
+#include "TCAArrayView.hpp"
+#include "TCAHit.hpp"
 
 // Forward declarations
+class TCAEventBlock;
 class TCAExperiment;
 
 class TCAEvent
@@ -18,6 +28,15 @@ class TCAEvent
 public:
     static inline constexpr int kNModules = 4;
 
+    // Module IDs, in the order of the module layout in CAConfiguration.hpp
+    enum ModuleID
+    {
+        kCloverCross = 0,
+        kCloverBack = 1,
+        kCeBrAll = 2,
+        kPosSig = 3
+    };
+
     enum FilterID
     {
         kAmplitude = 0,
@@ -30,12 +49,16 @@ public:
         kNFilters
     };
 
+    static inline constexpr std::array<const char*, kNFilters> kFilterNames = {"amplitude", "channel_time", "pileup", "module_timestamp", "trigger_time", "integration_long", "integration_short"};
+
     typedef std::array<TTreeReaderArray<double>*, kNModules * kNFilters> EventDataArray;
+    typedef std::bitset<kNModules * kNFilters> ColumnMask; // One bit per module/filter branch, indexed by GetColumn()
 
     // Constructors
     TCAEvent() = delete;
     TCAEvent(const TCAEvent&) = delete;
     TCAEvent(TCAExperiment* experiment);
+    TCAEvent(TCAExperiment* experiment, TTreeReader& reader, const ColumnMask& columns = ColumnMask().set()); // Only branches in columns are read
 
     // Destructor
     ~TCAEvent();
@@ -43,24 +66,83 @@ public:
     // Getters
 
     TCAExperiment* GetExperiment() const { return fExperiment; }
+    const TCAEventBlock* GetBlock() const { return fBlock; }
+    inline bool HasData(size_t moduleID, size_t filterID) const
+    {
+        const size_t slot = moduleID * kNFilters + filterID;
+        return fBlock != nullptr ? fBlockData[slot] != nullptr : fData[slot] != nullptr;
+    }
+    TCAHitView GetHits() const;              // Hits of the current block entry, empty unless the block's hit list was built
+    uint64_t GetFlags(size_t moduleID) const; // Flag word of a module in the current block entry, see TCAEventBlock::FlagLane, 0 without flags
+    static TString GetBranchName(size_t moduleID, size_t filterID);
+    static constexpr size_t GetColumn(size_t moduleID, size_t filterID) { return moduleID * kNFilters + filterID; }
 
     // Setters
 
     void SetExperiment(TCAExperiment* experiment) { fExperiment = experiment; }
+    void SetBlock(const TCAEventBlock* block); // Serve values from an event block instead of the tree reader, nullptr to unbind
+    inline void SetBlockEntry(size_t entry) { fBlockEntry = entry; }
 
     // Operators
     inline double operator()(size_t moduleID, size_t filterID, size_t idx = 0) const
     {
-        return (*fData[moduleID * kNFilters + filterID])[idx];
+        const size_t slot = moduleID * kNFilters + filterID;
+        if (fBlock != nullptr)
+            return fBlockData[slot][fBlockEntry * fBlockWidth[slot] + idx];
+        return (*fData[slot])[idx];
     }
     TTreeReaderArray<double>& operator[](size_t idx) const
     {
         return *fData[idx];
     }
 
+    // Compile-time accessors, e.g. Get<kCloverCross, kAmplitude>(ch). Get() is unchecked (checked when DEBUG >= 2), At() always checks
+    template <ModuleID M, FilterID F>
+    inline double Get(size_t idx = 0) const
+    {
+#if DEBUG >= 2
+        return At<M, F>(idx);
+#else
+        constexpr size_t slot = GetColumn(M, F);
+        if (fBlock != nullptr)
+            return fBlockData[slot][fBlockEntry * fBlockWidth[slot] + idx];
+        return (*fData[slot])[idx];
+#endif // DEBUG
+    }
+    template <ModuleID M, FilterID F>
+    double At(size_t idx = 0) const
+    {
+        constexpr size_t slot = GetColumn(M, F);
+        if (!HasData(M, F))
+        {
+            throw std::runtime_error(Form("[ERROR] Event holds no data for branch %s", GetBranchName(M, F).Data()));
+        }
+        const size_t width = fBlock != nullptr ? fBlockWidth[slot] : fData[slot]->GetSize();
+        if (idx >= width)
+        {
+            throw std::runtime_error(Form("[ERROR] Index %zu is out of range for branch %s with %zu values", idx, GetBranchName(M, F).Data(), width));
+        }
+        return fBlock != nullptr ? fBlockData[slot][fBlockEntry * fBlockWidth[slot] + idx] : (*fData[slot])[idx];
+    }
+    // All values of the current entry, contiguous for the vectorizer. Only block-bound events have them, empty otherwise
+    template <ModuleID M, FilterID F>
+    inline TCAArrayView View() const
+    {
+        constexpr size_t slot = GetColumn(M, F);
+        if (fBlock == nullptr || fBlockData[slot] == nullptr)
+            return TCAArrayView();
+        return TCAArrayView(fBlockData[slot] + fBlockEntry * fBlockWidth[slot], fBlockWidth[slot]);
+    }
+
 private:
     TCAExperiment* fExperiment = nullptr;
-    EventDataArray fData;
+    EventDataArray fData{}; // Unset (nullptr) for filters the run tree does not provide
+    std::array<std::unique_ptr<TTreeReaderArray<double>>, kNModules * kNFilters> fReaderArrays; // Own the readers behind fData
+
+    const TCAEventBlock* fBlock = nullptr;                          // Bound event block, if any
+    size_t fBlockEntry = 0;                                         // Current entry within the bound block
+    std::array<const double*, kNModules * kNFilters> fBlockData{}; // Column storage of the bound block
+    std::array<size_t, kNModules * kNFilters> fBlockWidth{};       // Values per entry of each block column
 };
 
 #endif // TCAEVENT_HPP
\ No newline at end of file
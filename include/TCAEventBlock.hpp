@@ -0,0 +1,162 @@
+#ifndef TCAEVENTBLOCK_HPP
+#define TCAEVENTBLOCK_HPP
+
+// Standard C++ includes
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// ROOT includes
+#include <TBranch.h>
+#include <TBufferFile.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderArray.h>
+
+// Project includes
+#include "TCAArrayView.hpp"
+#include "TCAEvent.hpp"
+#include "TCAHit.hpp"
+
+// One module/filter column of an event block, entries are stored back to back with a fixed width
+class TCAColumnView
+{
+public:
+    TCAColumnView() = default;
+    TCAColumnView(const double* data, size_t width, size_t entries) : fData(data), fWidth(width), fEntries(entries) {}
+
+    inline bool IsValid() const { return fData != nullptr; }
+    inline size_t GetWidth() const { return fWidth; }
+    inline size_t GetEntries() const { return fEntries; }
+    inline TCAArrayView Values() const { return TCAArrayView(fData, fWidth * fEntries); }              // All values of the block
+    inline TCAArrayView operator[](size_t entry) const { return TCAArrayView(fData + entry * fWidth, fWidth); } // Values of one entry
+    inline double operator()(size_t entry, size_t idx = 0) const { return fData[entry * fWidth + idx]; }
+
+private:
+    const double* fData = nullptr;
+    size_t fWidth = 0;
+    size_t fEntries = 0;
+};
+
+// Structure-of-arrays block of consecutive run tree entries, one contiguous column per module and filter
+class TCAEventBlock
+{
+public:
+    static inline constexpr size_t kNColumns = TCAEvent::kNModules * TCAEvent::kNFilters;
+    static inline constexpr Int_t kBulkBufferSize = 32 * 1024; // Initial size of the bulk read buffer, grows with the basket size
+
+    // Per-channel flags of one module in one entry are packed into one word, 16 bits (one per channel) per flag
+    enum FlagLane
+    {
+        kHitLane = 0,      // Channel has an amplitude (long integral for QDCs)
+        kPileUpLane = 16,  // Channel flagged as piled up
+        kNoTimeLane = 32,  // Channel has an amplitude but no channel time
+        kRejectedLane = 48 // Channel was blanked by RejectPileUp()
+    };
+
+    // What the sort does with piled-up channels before any histogram sees them
+    enum PileUpPolicy
+    {
+        kKeepPileUp = 0,  // Leave them alone, no flags are built
+        kTagPileUp = 1,   // Build flags, hits carry TCAHit::kPileUp
+        kRejectPileUp = 2 // Build flags and blank the piled-up channels
+    };
+
+    // Constructors
+    TCAEventBlock() = delete;
+    TCAEventBlock(const TCAEventBlock&) = delete;
+    TCAEventBlock(TTree* tree, size_t capacity, const TCAEvent::ColumnMask& columns = TCAEvent::ColumnMask().set()); // Only branches in columns are read
+    TCAEventBlock(const std::array<size_t, kNColumns>& widths, size_t capacity); // Tree-less block filled by a decoder, columns of width 0 are absent
+
+    // Destructor
+    ~TCAEventBlock();
+
+    // Getters
+    inline size_t GetCapacity() const { return fCapacity; }
+    inline size_t GetEntries() const { return fEntries; }
+    inline Long64_t GetFirstEntry() const { return fFirstEntry; }
+    inline bool HasData(size_t moduleID, size_t filterID) const { return fColumns[moduleID * TCAEvent::kNFilters + filterID].fPresent; }
+    inline size_t GetWidth(size_t moduleID, size_t filterID) const { return fColumns[moduleID * TCAEvent::kNFilters + filterID].fWidth; }
+    inline size_t GetBulkColumnCount() const { return fNBulkColumns; }
+    inline bool HasHits() const { return fHitOffsets.size() == fEntries + 1; } // BuildHits() ran since the last read
+    inline bool HasFlags() const { return fEntries > 0 && fFlags.size() == fEntries * TCAEvent::kNModules; } // BuildFlags() ran since the last read
+    inline uint64_t GetFlags(size_t entry, size_t moduleID) const { return fFlags[entry * TCAEvent::kNModules + moduleID]; }
+    inline uint16_t GetFlags(size_t entry, size_t moduleID, FlagLane lane) const { return static_cast<uint16_t>(GetFlags(entry, moduleID) >> lane); }
+    inline size_t GetHitCount() const { return fHits.size(); }
+    inline TCAHitView Hits(size_t entry) const { return TCAHitView(fHits.data() + fHitOffsets[entry], fHitOffsets[entry + 1] - fHitOffsets[entry]); }
+
+    inline TCAColumnView View(size_t moduleID, size_t filterID) const
+    {
+        const auto& column = fColumns[moduleID * TCAEvent::kNFilters + filterID];
+        return column.fPresent ? TCAColumnView(column.fValues.data(), column.fWidth, fEntries) : TCAColumnView();
+    }
+
+    // As View() with the column resolved at compile time, e.g. View<TCAEvent::kCloverCross, TCAEvent::kAmplitude>()
+    template <TCAEvent::ModuleID M, TCAEvent::FilterID F>
+    inline TCAColumnView View() const
+    {
+        constexpr size_t column = TCAEvent::GetColumn(M, F);
+        return fColumns[column].fPresent ? TCAColumnView(fColumns[column].fValues.data(), fColumns[column].fWidth, fEntries) : TCAColumnView();
+    }
+
+    // Raw column storage of capacity * width values, stable for the lifetime of the block
+    inline const double* GetColumnData(size_t column) const { return fColumns[column].fPresent ? fColumns[column].fValues.data() : nullptr; }
+    inline size_t GetColumnWidth(size_t column) const { return fColumns[column].fWidth; }
+    inline double* GetMutableColumnData(size_t column) { return fColumns[column].fPresent ? fColumns[column].fValues.data() : nullptr; }
+
+    // Operators
+    inline double operator()(size_t entry, size_t moduleID, size_t filterID, size_t idx = 0) const
+    {
+        const auto& column = fColumns[moduleID * TCAEvent::kNFilters + filterID];
+        return column.fValues[entry * column.fWidth + idx];
+    }
+
+    // Methods
+    size_t Read(Long64_t firstEntry, Long64_t lastEntry); // Read up to capacity entries of [firstEntry, lastEntry), returns entries read
+    size_t SetRange(Long64_t firstEntry, Long64_t lastEntry); // As Read() for decoders filling the columns themselves
+    void BuildHits(double threshold);                         // Collect the channels with an amplitude above threshold, per entry
+    void BuildFlags();                                        // Pack the per-channel flags of every module and entry
+    size_t RejectPileUp();                                    // Blank the values of piled-up channels, needs flags, returns the channels blanked
+    size_t Compact(const std::vector<bool>& keep);            // Drop entries not marked in keep, the rest move up and are no longer consecutive
+
+private:
+    struct Column
+    {
+        bool fPresent = false;      // Branch exists in the run tree and is read
+        bool fBulk = false;         // Branch is read through ROOT's bulk API rather than a TTreeReaderArray
+        size_t fWidth = 0;          // Values per entry
+        TBranch* fBranch = nullptr; // Branch backing this column
+        std::vector<double> fValues;
+        std::unique_ptr<TTreeReaderArray<double>> fReaderArray; // Fallback reader for branches without bulk support
+    };
+
+    void ReadBulkColumn(Column& column, Long64_t firstEntry, size_t nEntries);
+    void ReadReaderColumns(Long64_t firstEntry, size_t nEntries);
+
+    TTree* fTree = nullptr;
+    size_t fCapacity = 0;
+    size_t fEntries = 0;
+    Long64_t fFirstEntry = 0;
+    size_t fNBulkColumns = 0;
+    std::array<Column, kNColumns> fColumns;
+    std::vector<TCAHit> fHits;         // Hits of all entries, back to back
+    std::vector<uint32_t> fHitOffsets; // First hit of each entry in fHits, plus the end of the last entry
+    std::vector<uint64_t> fFlags;      // Flag words, kNModules per entry
+    std::unique_ptr<TTreeReader> fReader; // Only created when some column falls back to TTreeReaderArray
+    TBufferFile fBulkBuffer;
+};
+
+// Thread-safe producer of event blocks shared by all workers, for inputs that need no per-worker setup (listfiles, hit caches)
+class TCAVirtualBlockSource
+{
+public:
+    virtual ~TCAVirtualBlockSource() = default;
+
+    virtual Long64_t GetEntries() const = 0;
+    virtual std::array<size_t, TCAEventBlock::kNColumns> GetColumnWidths() const = 0;            // Layout of the blocks produced by Read()
+    virtual size_t GetNaturalBlockSize() const { return 0; }                                       // Entries per stored block if reads should align to it, 0 otherwise
+    virtual size_t Read(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry) const = 0; // Fill up to the block capacity of [firstEntry, lastEntry)
+};
+
+#endif // TCAEVENTBLOCK_HPP
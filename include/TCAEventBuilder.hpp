@@ -0,0 +1,59 @@
+#ifndef TCAEVENTBUILDER_HPP
+#define TCAEVENTBUILDER_HPP
+
+// Standard C++ includes
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "TCAEventBlock.hpp"
+
+// Builds events from free-running modules. Each entry of the upstream source holds the readouts of some modules, marked by a
+// module timestamp; the per-module streams are merged by timestamp and readouts within the coincidence window of the first
+// readout of an event are combined into one output entry with the usual module/filter layout.
+//
+// Upstream entry ranges are built independently, so workers build different ranges in parallel. Ranges are cut at the first
+// gap longer than the window after the earliest timestamp of the boundary entries; the cut only depends on the data around
+// the boundary, so both neighbours agree on which of them owns an event that straddles it. Modules may run up to kMaxSkew
+// upstream entries ahead of each other.
+class TCAEventBuilder : public TCAVirtualBlockSource
+{
+public:
+    static inline constexpr Long64_t kMaxSkew = 256; // Upstream entries a readout may lag behind the readouts it coincides with
+
+    // Constructors
+    TCAEventBuilder() = delete;
+    TCAEventBuilder(const TCAEventBuilder&) = delete;
+    TCAEventBuilder(std::unique_ptr<TCAVirtualBlockSource> source, double coincidenceWindow);
+
+    // Getters
+    inline double GetCoincidenceWindow() const { return fCoincidenceWindow; }
+    inline Long64_t GetEntries() const override { return fSource->GetEntries(); } // Upstream entries, built events are only known once built
+    std::array<size_t, TCAEventBlock::kNColumns> GetColumnWidths() const override { return fSource->GetColumnWidths(); }
+
+    // Methods
+    // Builds the events owned by upstream entries [firstEntry, lastEntry), as many as fit in the block. Returns the number of
+    // upstream entries consumed, the block holds the events built from them.
+    size_t Read(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry) const override;
+
+private:
+    struct Readout
+    {
+        double fTime;      // Module timestamp
+        uint32_t fRow;     // Row of the upstream block holding the readout
+        uint16_t fModuleID;
+    };
+
+    std::vector<Readout> MergeReadouts(const TCAEventBlock& input) const; // Readouts of all modules in timestamp order
+    double GetCut(const std::vector<Readout>& readouts, Long64_t entry, Long64_t firstInput, bool lowerEdge) const; // Timestamp where building restarts at an entry boundary
+    size_t Build(const TCAEventBlock& input, TCAEventBlock& output, Long64_t firstEntry, Long64_t lastEntry) const; // Returns the number of events, even beyond the capacity
+
+    std::unique_ptr<TCAVirtualBlockSource> fSource;
+    double fCoincidenceWindow;
+};
+
+#endif // TCAEVENTBUILDER_HPP
@@ -0,0 +1,62 @@
+#ifndef TCAEVENTPOOL_HPP
+#define TCAEVENTPOOL_HPP
+
+// Standard C++ includes
+#include <memory>
+#include <string>
+#include <vector>
+
+// ROOT includes
+#include <TFile.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+
+// Project includes
+#include "TCAEvent.hpp"
+
+// Forward declarations
+class TCAExperiment;
+
+// Fixed set of per-worker run readers. Each slot opens its own copy of the run once and binds one TTreeReader and one
+// TCAEvent to it, so moving a worker to another entry range only moves the reader: branch readers and the tree cache
+// are set up on first use and kept until the pool goes away. Each slot must only be used by one thread at a time.
+class TCAEventPool
+{
+public:
+    // Constructors
+    TCAEventPool() = delete;
+    TCAEventPool(const TCAEventPool&) = delete;
+    TCAEventPool(TCAExperiment* experiment, const std::string& runFileName, size_t nSlots, const TCAEvent::ColumnMask& columns);
+
+    // Destructor
+    ~TCAEventPool();
+
+    // Getters
+    inline size_t GetSlotCount() const { return fSlots.size(); }
+    inline const std::string& GetRunFileName() const { return fRunFileName; }
+    inline const TCAEvent::ColumnMask& GetColumns() const { return fColumns; }
+    bool IsCompatible(const std::string& runFileName, size_t nSlots, const TCAEvent::ColumnMask& columns) const; // Can serve a sort of this shape
+
+    TTree* GetTree(size_t slot);          // The slot's copy of the run tree, opened on first use, throws if it cannot be read
+    TTreeReader& GetReader(size_t slot);  // Reader of the slot's tree, created on first use
+    TCAEvent& GetEvent(size_t slot);      // Event bound to the slot's reader, reading only the pool's columns
+
+    // Methods
+    TTreeReader::EEntryStatus SetRange(size_t slot, Long64_t firstEntry, Long64_t lastEntry); // Move the slot's reader to [firstEntry, lastEntry)
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<TFile> fFile;
+        TTree* fTree = nullptr;               // Owned by fFile
+        std::unique_ptr<TTreeReader> fReader;
+        std::unique_ptr<TCAEvent> fEvent;     // Destroyed before fReader, its branch readers are registered there
+    };
+
+    TCAExperiment* fExperiment = nullptr;
+    std::string fRunFileName;
+    TCAEvent::ColumnMask fColumns;
+    std::vector<Slot> fSlots;
+};
+
+#endif // TCAEVENTPOOL_HPP
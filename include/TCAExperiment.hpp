@@ -0,0 +1,156 @@
+#ifndef TCAEXPERIMENT_HPP
+#define TCAEXPERIMENT_HPP
+
+// Standard C++ includes
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "CAConfiguration.hpp"
+#include "TCABoundedQueue.hpp"
+#include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+#include "TCAEntryIndex.hpp"
+#include "TCAHistogramOwner.hpp"
+#include "TCAOutputWriter.hpp"
+
+// Forward declarations
+class TCADAQModule;
+class TCAEventPool;
+class TCAFillBuffer;
+class TCAHitCacheWriter;
+class TCASnapshotWriter;
+class TCAVirtualBlockSource;
+class TCAWorkQueue;
+
+class TCAExperiment : public TCAHistogramOwner
+{
+public:
+    typedef std::pair<Long64_t, Long64_t> EntryRange; // Entries [first, second) of the run tree
+
+    struct PrefetchedBlock
+    {
+        size_t fSlot = 0;                // I/O thread owning the block
+        TCAEventBlock* fBlock = nullptr;
+        size_t fEntries = 0;             // Entries read into the block, counted before unselected entries are dropped
+    };
+    typedef TCABoundedQueue<PrefetchedBlock> BlockQueue;
+
+    static inline constexpr Long64_t kMinEntriesPerRange = 10000;   // Smallest range handed to a worker, keeps reader setup cheap
+    static inline constexpr size_t kRangesPerThread = 16;           // Ranges per worker, enough for work stealing to even out slow ranges
+    static inline constexpr uint64_t kProgressUpdateEntries = 1024; // Entries processed between updates of the shared progress counter
+    static inline constexpr Long64_t kMinSelectionGap = 1024;       // Unselected entries read anyway rather than starting a new read
+    static inline constexpr size_t kLargeMergeCells = 1 << 20;      // Histograms with this many bins merge one at a time on all threads
+
+    // Constructors
+    TCAExperiment(const char* name, const char* title);
+
+    // Destructor
+    virtual ~TCAExperiment();
+
+    // Getters
+    inline size_t GetModuleCount() const { return fModules.size(); }
+    inline TCADAQModule* GetModule(size_t index) const { return fModules.at(index).get(); }
+    inline unsigned int GetNThreads() const { return fNThreads; }
+    inline Long64_t GetEntries() const { return fEntries; }
+    inline size_t GetBlockSize() const { return fBlockSize; }
+    inline unsigned int GetNIOThreads() const { return fNIOThreads; }
+    inline size_t GetPrefetchDepth() const { return fPrefetchDepth; }
+    size_t GetReadBlockSize() const; // Block size actually used for the open run, 0 when reading entry by entry
+    std::vector<TCAHistogramOwner*> GetHistogramOwners() const;
+    std::vector<TCAVirtualHistogram*> GetHistograms() const; // Histograms of every owner
+    // Every owner with its directory in the output, one per module, detector and channel, "" for the experiment's own
+    std::vector<std::pair<TCAHistogramOwner*, std::string>> GetOwnerDirectories() const;
+    TCAEvent::ColumnMask GetActiveColumns() const; // Branches the next Sort() reads, the union of the histogram dependencies
+
+    // Setters
+    inline void SetNThreads(unsigned int nThreads) { fNThreads = std::max(1U, nThreads); }
+    inline void SetBlockSize(size_t blockSize) { fBlockSize = blockSize; } // 0 reads entry by entry through TTreeReader
+    inline void SetNIOThreads(unsigned int nIOThreads) { fNIOThreads = nIOThreads; } // Read-ahead threads on top of the workers, 0 reads inline
+    inline void SetCoincidenceWindow(double window) { fCoincidenceWindow = window; }   // Build events from free-running listfiles, negative to read events as stored
+    inline void SetPileUpPolicy(TCAEventBlock::PileUpPolicy policy) { fPileUpPolicy = policy; } // Tag or reject piled-up channels at decode time
+    inline void SetBuildHits(bool buildHits) { fBuildHits = buildHits; }              // Collect per-event hit lists when blocks are decoded
+    inline void SetHitThreshold(double threshold) { fHitThreshold = threshold; }      // Raw amplitude a channel needs to enter the hit list
+    inline void SetFillBufferSize(size_t size) { fFillBufferSize = size; } // Fills of flat histograms buffered per worker, 0 fills directly
+    inline void SetPrefetchDepth(size_t depth) { fPrefetchDepth = std::max<size_t>(1, depth); } // Decoded blocks queued ahead of the workers
+    inline void SetHitCacheFile(const std::string& fileName) { fHitCacheFileName = fileName; } // Sort from this cache, or write it while sorting
+    inline void SetShowProgress(bool showProgress) { fShowProgress = showProgress; }            // Off when several runs sort side by side
+    inline void SetEntryIndexFile(const std::string& fileName) { fEntryIndexFileName = fileName; } // Write the entry index while sorting, or gate on it with SetSelection()
+    void SetSelection(const std::string& selection); // Only sort entries of this coincidence class, e.g. "gg", empty sorts every entry
+    // Write the histograms to fileName every interval seconds and/or every entryInterval entries while sorting, 0 for never
+    void SetSnapshots(const std::string& fileName, double interval, uint64_t entryInterval);
+
+    // Methods
+    TCADAQModule* AddModule(const char* name, const char* title, const char* type, size_t moduleID);
+    void BuildDetectorTree();
+    void OpenRun(const std::string& runFileName);
+    void Sort();
+    void MergeHistograms(); // Merge the per-thread replicas of every histogram, histograms side by side on the sort threads
+    // Merged histograms ready for writing, converted side by side on the sort threads. They outlive the experiment, so
+    // the output can be handed to a TCAOutputWriter and the experiment released while it is written
+    TCAOutputWriter::Items CollectOutput();
+    void WriteOutput(const std::string& outputFileName); // CollectOutput() written on the calling thread
+    void WriteSnapshot(const std::string& fileName); // Histograms as last published by the workers, called during Sort()
+    void Accumulate(TCAExperiment& other); // Adds the histograms of an experiment built the same way, e.g. another run
+    virtual void PrintInfo() const;
+
+protected:
+    inline bool IsSelecting() const { return fEntryIndex && !fWriteEntryIndex; } // Sort() only reads the entries of fSelection
+    void OpenEntryIndex(); // Read the index a selection gates on, or start the one this sort writes
+    std::vector<EntryRange> MakeEntryRanges() const;
+    void SortWorker(size_t slot, TCAWorkQueue& workQueue, std::atomic<uint64_t>& processedEntries);
+    void SortRanges(size_t slot, TCAWorkQueue& workQueue, std::atomic<uint64_t>& processedEntries); // SortWorker() without the error handling
+    void PrefetchWorker(size_t slot, TCAWorkQueue& workQueue, BlockQueue& filledBlocks, BlockQueue& freeBlocks, size_t nBlocks);
+    void PrefetchedSortWorker(size_t worker, TCAWorkQueue& workQueue, BlockQueue& filledBlocks, std::vector<std::unique_ptr<BlockQueue>>& freeBlocks, std::atomic<uint64_t>& processedEntries);
+    void StopSort(TCAWorkQueue& workQueue); // From a worker's catch block, keeps the first exception for Sort() to rethrow
+    std::unique_ptr<TCAFillBuffer> MakeFillers(std::vector<TCAVirtualHistogram::Filler>& fillers, std::vector<TCAVirtualHistogram::BlockFiller>& blockFillers); // Bind to the calling thread, the buffer must outlive the fillers' use
+    std::array<size_t, TCAEventBlock::kNColumns> GetBlockSourceWidths() const; // Column widths of the block source without pruned columns
+    size_t ReadBlock(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry);   // Decode, write to the hit cache, then finish
+    size_t DecodeBlock(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry); // Read from the block source or the block's tree, drop unselected entries
+    void FinishBlock(TCAEventBlock& block);                                            // Flag, reject pile-up, fill the entry index and build hits
+    void ProcessBlock(const TCAEventBlock& block, TCAEvent& event, std::vector<TCAVirtualHistogram::Filler>& fillers, std::vector<TCAVirtualHistogram::BlockFiller>& blockFillers);
+
+    std::vector<std::unique_ptr<TCADAQModule>> fModules; // DAQ modules, each owning its channels and detectors
+    std::string fRunFileName;                            // Run file currently being sorted
+    std::vector<EntryRange> fClusters;                   // Cluster boundaries of the run tree, empty for block sources
+    std::unique_ptr<TCAEventPool> fEventPool;            // Per-worker readers of the run tree, kept across sorts of the same run
+    std::unique_ptr<TCAVirtualBlockSource> fBlockSource; // Shared source when the run is not read from a run tree (listfile, hit cache)
+    std::string fHitCacheFileName;                       // Hit cache to sort from or to write, empty for none
+    std::unique_ptr<TCAHitCacheWriter> fHitCacheWriter;  // Writes the hit cache during the next Sort()
+    std::string fEntryIndexFileName;                     // Entry index to gate on or to write, empty for none
+    std::unique_ptr<TCAEntryIndex> fEntryIndex;          // Index read for the selection, or filled during the next Sort()
+    bool fWriteEntryIndex = false;                       // fEntryIndex is filled and written by the next Sort()
+    std::string fSelection;                              // Coincidence class entries need to be sorted, empty for all entries
+    TCAEntryIndex::Selection fSelectionClasses = {};     // fSelection as multiplicities per detector class
+    Long64_t fEntries = 0;                               // Number of entries in the run tree
+    TCAEvent::ColumnMask fActiveColumns;                 // Branches read by the running Sort(), see GetActiveColumns()
+    unsigned int fNThreads = kMaxThreads;                // Number of worker threads used by Sort()
+    size_t fBlockSize = kDefaultBlockSize;               // Entries per event block, 0 reads entry by entry
+    bool fShowProgress = true;                           // Draw a progress bar during Sort()
+    std::string fSnapshotFileName;                       // Snapshots written during Sort(), empty for none
+    double fSnapshotInterval = 0.0;                      // Seconds between snapshots, 0 for no timed snapshots
+    uint64_t fSnapshotEntries = 0;                       // Entries between snapshots, 0 for none
+    std::unique_ptr<TCASnapshotWriter> fSnapshotWriter;  // Exists during Sort() when snapshots are enabled
+    unsigned int fNIOThreads = kDefaultIOThreads;        // Threads reading and decompressing blocks ahead of the workers
+    size_t fPrefetchDepth = kDefaultPrefetchDepth;       // Decoded blocks waiting for a worker at most
+    size_t fFillBufferSize = kDefaultFillBufferSize;     // Capacity of each worker's TCAFillBuffer, 0 for none
+    double fCoincidenceWindow = kDefaultCoincidenceWindow; // Event builder window in module timestamp ticks, negative when not building
+    TCAEventBlock::PileUpPolicy fPileUpPolicy = TCAEventBlock::kKeepPileUp; // Applied to every block before the fillers
+    std::atomic<uint64_t> fRejectedHits = 0;             // Piled-up channels blanked during the running Sort()
+    std::mutex fSortErrorMutex;
+    std::exception_ptr fSortError;                       // First exception thrown by a thread of the running Sort(), guarded by fSortErrorMutex
+    std::atomic<bool> fSortFailed = false;               // Set with fSortError, the workers then only hand blocks back
+    bool fBuildHits = false;                             // Build hit lists of the decoded blocks, see TCAEvent::GetHits()
+    double fHitThreshold = kDefaultHitThreshold;         // Raw amplitude threshold of the hit lists
+};
+
+#endif // TCAEXPERIMENT_HPP
@@ -0,0 +1,78 @@
+#ifndef TCAFILLBUFFER_HPP
+#define TCAFILLBUFFER_HPP
+
+// Standard C++ includes
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+
+// Forward declarations
+class TCAFillBuffer;
+
+// Histogram replica whose unweighted fills can be deferred to a TCAFillBuffer, see TCAFlatH1
+class TCAFillTarget
+{
+public:
+    // Constructors
+    TCAFillTarget() = default;
+    TCAFillTarget(const TCAFillTarget&) {} // Copies start unbuffered, a buffer belongs to one replica
+
+    // Destructor
+    virtual ~TCAFillTarget() = default;
+
+    // Getters
+    inline TCAFillBuffer* GetFillBuffer() const { return fFillBuffer; }
+
+    // Setters
+    void SetFillBuffer(TCAFillBuffer* buffer); // Defer fills to buffer, nullptr fills directly again
+
+    // Methods
+    virtual void ApplyFills(const uint32_t* bins, size_t nFills) = 0; // Add one count to each bin, called by the buffer on flush
+
+protected:
+    TCAFillBuffer* fFillBuffer = nullptr;
+    uint32_t fFillBufferID = 0; // Index of this target in fFillBuffer
+};
+
+// Per-thread buffer of (histogram, bin) fills. Events touch hundreds of spectra in turn, each fill landing on a different
+// cache line; buffered fills are bucketed by histogram on flush and applied one histogram at a time, so each histogram's
+// bins are pulled into cache once per flush. Only used by one thread, flushes and detaches its targets when destroyed.
+class TCAFillBuffer
+{
+public:
+    // Constructors
+    explicit TCAFillBuffer(size_t capacity);
+    TCAFillBuffer(const TCAFillBuffer&) = delete;
+
+    // Destructor
+    ~TCAFillBuffer();
+
+    // Getters
+    inline size_t GetCapacity() const { return fFills.size(); }
+    inline size_t GetTargetCount() const { return fTargets.size(); }
+    inline uint64_t GetFlushCount() const { return fNFlushes; }
+
+    // Methods
+    uint32_t Register(TCAFillTarget* target); // Called by TCAFillTarget::SetFillBuffer()
+    inline void Push(uint32_t target, uint32_t bin)
+    {
+        fFills[fSize++] = static_cast<uint64_t>(target) << 32 | bin;
+        if (fSize == fFills.size())
+            Flush();
+    }
+    void Flush(); // Apply all buffered fills
+
+private:
+    std::vector<TCAFillTarget*> fTargets;
+    std::vector<uint64_t> fFills;    // Target in the upper, bin in the lower 32 bits
+    size_t fSize = 0;                // Buffered fills
+    std::vector<uint32_t> fOffsets;  // First fill of each target after bucketing, plus the end
+    std::vector<uint32_t> fBucketed; // Bins of the buffered fills, grouped by target
+    uint64_t fNFlushes = 0;
+};
+
+#endif // TCAFILLBUFFER_HPP
@@ -0,0 +1,253 @@
+#ifndef TCAFLATHISTOGRAM_HPP
+#define TCAFLATHISTOGRAM_HPP
+
+// Standard C++ includes
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ROOT includes
+#include <TH1D.h>
+#include <TH2D.h>
+#include <TString.h>
+
+// Project includes
+#include "TCAFillBuffer.hpp"
+
+// CASort-native fixed-binning histograms with flat storage, used through TCAHistogram like any ROOT histogram, e.g.
+// TCAHistogram<TCAFlatH1I>. A fill is one multiply, one clamp and one add: no virtual call, no axis lookup and no
+// statistics. They turn into TH1D/TH2D only when merged for writing, with the statistics recomputed from the bins.
+// Bins are laid out as in ROOT, 0 is the underflow and nBins + 1 the overflow. NaN lands in the underflow.
+// Unweighted fills of a replica given a TCAFillBuffer only compute the bin and leave the add to the buffer's flush.
+// Bins are allocated on the first fill, a replica of a channel that never fires in its thread costs only its binning.
+
+// Bin of x on a fixed axis, scale is nBins / (max - min) and overflow is nBins + 1
+inline size_t CAFlatBin(double x, double min, double scale, double overflow)
+{
+    double u = (x - min) * scale + 1.0;
+    u = u > 0.0 ? u : 0.0; // Also catches NaN
+    u = u < overflow ? u : overflow;
+    return static_cast<size_t>(u);
+}
+
+template <typename S>
+class TCAFlatH1 : public TCAFillTarget
+{
+public:
+    typedef S StorageType;
+
+    // Constructors
+    TCAFlatH1(const char* name, const char* title, int nBins, double min, double max)
+        : fName(name), fTitle(title), fNBins(nBins), fMin(min), fMax(max), fScale(nBins / (max - min)), fOverflow(nBins + 1.0)
+    {
+        if (nBins <= 0 || !(max > min))
+        {
+            throw std::runtime_error(Form("[ERROR] Histogram %s needs at least one bin and max > min", name));
+        }
+    }
+
+    // Getters
+    inline const char* GetName() const { return fName.c_str(); }
+    inline const char* GetTitle() const { return fTitle.c_str(); }
+    inline int GetNbinsX() const { return fNBins; }
+    inline double GetXmin() const { return fMin; }
+    inline double GetXmax() const { return fMax; }
+    inline size_t GetNcells() const { return static_cast<size_t>(fNBins) + 2; }
+    inline uint64_t GetEntries() const { return fEntries; }
+    inline bool IsAllocated() const { return !fBins.empty(); }
+    inline size_t GetAllocatedBytes() const { return fBins.size() * sizeof(S); }
+    inline S GetBinContent(size_t bin) const { return IsAllocated() ? fBins[bin] : S(); }
+    inline size_t FindBin(double x) const { return CAFlatBin(x, fMin, fScale, fOverflow); }
+
+    // Methods
+    inline void Fill(double x)
+    {
+        if (fFillBuffer != nullptr)
+        {
+            fFillBuffer->Push(fFillBufferID, static_cast<uint32_t>(FindBin(x)));
+            return;
+        }
+        Allocate();
+        fBins[FindBin(x)] += 1;
+        fEntries++;
+    }
+    inline void Fill(double x, double weight) // Integer storage truncates the weight
+    {
+        Allocate();
+        fBins[FindBin(x)] += static_cast<S>(weight);
+        fEntries++;
+    }
+    void ApplyFills(const uint32_t* bins, size_t nFills) override
+    {
+        Allocate();
+        for (size_t i = 0; i < nFills; i++)
+            fBins[bins[i]] += 1;
+        fEntries += nFills;
+    }
+    void Add(const TCAFlatH1* other)
+    {
+        if (other->fNBins != fNBins || other->fMin != fMin || other->fMax != fMax)
+        {
+            throw std::runtime_error(Form("[ERROR] Cannot add histogram %s to %s, their binning differs", other->GetName(), GetName()));
+        }
+        fEntries += other->fEntries;
+        if (!other->IsAllocated()) // Never filled, e.g. a replica of a dead channel
+            return;
+        Allocate();
+        for (size_t bin = 0; bin < fBins.size(); bin++)
+            fBins[bin] += other->fBins[bin];
+    }
+    void Reset() // Also releases the bins
+    {
+        std::vector<S>().swap(fBins);
+        fEntries = 0;
+    }
+    std::unique_ptr<TH1D> ToROOT() const
+    {
+        auto hist = std::make_unique<TH1D>(fName.c_str(), fTitle.c_str(), fNBins, fMin, fMax);
+        hist->SetDirectory(nullptr);
+        for (size_t bin = 0; bin < fBins.size(); bin++)
+            hist->SetBinContent(static_cast<Int_t>(bin), static_cast<Double_t>(fBins[bin]));
+        hist->ResetStats(); // Mean and RMS from the bin centres
+        hist->SetEntries(static_cast<Double_t>(fEntries));
+        return hist;
+    }
+    Int_t Write(const char* name = nullptr, Int_t option = 0, Int_t bufsize = 0) const { return ToROOT()->Write(name, option, bufsize); }
+
+private:
+    inline void Allocate()
+    {
+        if (fBins.empty())
+            fBins.assign(GetNcells(), S());
+    }
+
+    std::string fName;
+    std::string fTitle;
+    int fNBins;
+    double fMin;
+    double fMax;
+    double fScale;    // Bins per unit of x
+    double fOverflow; // Index of the overflow bin as a double, the clamp limit of CAFlatBin()
+    uint64_t fEntries = 0;
+    std::vector<S> fBins; // Empty until the first fill
+};
+
+template <typename S>
+class TCAFlatH2 : public TCAFillTarget
+{
+public:
+    typedef S StorageType;
+
+    // Constructors
+    TCAFlatH2(const char* name, const char* title, int nBinsX, double xMin, double xMax, int nBinsY, double yMin, double yMax)
+        : fName(name), fTitle(title), fNBinsX(nBinsX), fNBinsY(nBinsY), fXMin(xMin), fXMax(xMax), fYMin(yMin), fYMax(yMax),
+          fXScale(nBinsX / (xMax - xMin)), fYScale(nBinsY / (yMax - yMin)), fXOverflow(nBinsX + 1.0), fYOverflow(nBinsY + 1.0)
+    {
+        if (nBinsX <= 0 || nBinsY <= 0 || !(xMax > xMin) || !(yMax > yMin))
+        {
+            throw std::runtime_error(Form("[ERROR] Histogram %s needs at least one bin and max > min on both axes", name));
+        }
+    }
+
+    // Getters
+    inline const char* GetName() const { return fName.c_str(); }
+    inline const char* GetTitle() const { return fTitle.c_str(); }
+    inline int GetNbinsX() const { return fNBinsX; }
+    inline int GetNbinsY() const { return fNBinsY; }
+    inline size_t GetNcells() const { return static_cast<size_t>(fNBinsX + 2) * (fNBinsY + 2); }
+    inline uint64_t GetEntries() const { return fEntries; }
+    inline bool IsAllocated() const { return !fBins.empty(); }
+    inline size_t GetAllocatedBytes() const { return fBins.size() * sizeof(S); }
+    inline size_t GetBin(size_t binX, size_t binY) const { return binY * (fNBinsX + 2) + binX; } // As TH2::GetBin()
+    inline S GetBinContent(size_t binX, size_t binY) const { return IsAllocated() ? fBins[GetBin(binX, binY)] : S(); }
+    inline size_t FindBin(double x, double y) const { return GetBin(CAFlatBin(x, fXMin, fXScale, fXOverflow), CAFlatBin(y, fYMin, fYScale, fYOverflow)); }
+
+    // Methods
+    inline void Fill(double x, double y)
+    {
+        if (fFillBuffer != nullptr)
+        {
+            fFillBuffer->Push(fFillBufferID, static_cast<uint32_t>(FindBin(x, y)));
+            return;
+        }
+        Allocate();
+        fBins[FindBin(x, y)] += 1;
+        fEntries++;
+    }
+    inline void Fill(double x, double y, double weight) // Integer storage truncates the weight
+    {
+        Allocate();
+        fBins[FindBin(x, y)] += static_cast<S>(weight);
+        fEntries++;
+    }
+    void ApplyFills(const uint32_t* bins, size_t nFills) override
+    {
+        Allocate();
+        for (size_t i = 0; i < nFills; i++)
+            fBins[bins[i]] += 1;
+        fEntries += nFills;
+    }
+    void Add(const TCAFlatH2* other)
+    {
+        if (other->fNBinsX != fNBinsX || other->fNBinsY != fNBinsY || other->fXMin != fXMin || other->fXMax != fXMax || other->fYMin != fYMin || other->fYMax != fYMax)
+        {
+            throw std::runtime_error(Form("[ERROR] Cannot add histogram %s to %s, their binning differs", other->GetName(), GetName()));
+        }
+        fEntries += other->fEntries;
+        if (!other->IsAllocated()) // Never filled, e.g. a replica of a dead channel
+            return;
+        Allocate();
+        for (size_t bin = 0; bin < fBins.size(); bin++)
+            fBins[bin] += other->fBins[bin];
+    }
+    void Reset() // Also releases the bins
+    {
+        std::vector<S>().swap(fBins);
+        fEntries = 0;
+    }
+    std::unique_ptr<TH2D> ToROOT() const
+    {
+        auto hist = std::make_unique<TH2D>(fName.c_str(), fTitle.c_str(), fNBinsX, fXMin, fXMax, fNBinsY, fYMin, fYMax);
+        hist->SetDirectory(nullptr);
+        for (size_t bin = 0; bin < fBins.size(); bin++)
+            hist->SetBinContent(static_cast<Int_t>(bin), static_cast<Double_t>(fBins[bin]));
+        hist->ResetStats();
+        hist->SetEntries(static_cast<Double_t>(fEntries));
+        return hist;
+    }
+    Int_t Write(const char* name = nullptr, Int_t option = 0, Int_t bufsize = 0) const { return ToROOT()->Write(name, option, bufsize); }
+
+private:
+    inline void Allocate()
+    {
+        if (fBins.empty())
+            fBins.assign(GetNcells(), S());
+    }
+
+    std::string fName;
+    std::string fTitle;
+    int fNBinsX;
+    int fNBinsY;
+    double fXMin;
+    double fXMax;
+    double fYMin;
+    double fYMax;
+    double fXScale;
+    double fYScale;
+    double fXOverflow;
+    double fYOverflow;
+    uint64_t fEntries = 0;
+    std::vector<S> fBins; // Rows of nBinsX + 2 cells, one per y bin including under- and overflow, empty until the first fill
+};
+
+typedef TCAFlatH1<uint32_t> TCAFlatH1I; // Counts
+typedef TCAFlatH1<float> TCAFlatH1F;    // Weighted fills
+typedef TCAFlatH1<double> TCAFlatH1D;
+typedef TCAFlatH2<uint32_t> TCAFlatH2I;
+typedef TCAFlatH2<float> TCAFlatH2F;
+typedef TCAFlatH2<double> TCAFlatH2D;
+
+#endif // TCAFLATHISTOGRAM_HPP
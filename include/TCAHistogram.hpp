@@ -2,23 +2,96 @@
 #define TCAHISTOGRAM_HPP
 
 // Standard C++ includes
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 // ROOT includes
 #include <ROOT/TThreadedObject.hxx>
+#include <TDirectory.h>
+#include <TNamed.h>
+#include <TString.h>
 
 // Project includes
 #include "CAConfiguration.hpp"
+#include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+#include "TCAFlatHistogram.hpp"
+#include "TCAThreadedObject.hpp"
+#include "TCATiledHistogram.hpp"
 
-// Forward declarations
-class TCAEvent;
+// Per-thread replica container of a histogram type, ROOT's for ROOT histograms and CASort's own for the native
+// histograms (flat and tiled), which all derive from TCAFillTarget
+template <typename T, typename Enable = void>
+struct TCAHistogramReplicas
+{
+    typedef ROOT::TThreadedObject<T> Type;
+};
+template <typename T>
+struct TCAHistogramReplicas<T, std::enable_if_t<std::is_base_of_v<TCAFillTarget, T>>>
+{
+    typedef TCAThreadedObject<T> Type;
+};
+
+// Type-erased interface used by the sort engine to drive histograms of any type
+class TCAVirtualHistogram : public TNamed
+{
+public:
+    typedef std::function<void(TCAEvent* event)> Filler;
+    typedef std::function<void(const TCAEventBlock& block)> BlockFiller;
+    typedef std::function<void()> Publisher; // Copies one thread's replica for the snapshots, see TCASnapshotWriter
+    typedef std::pair<size_t, TCAEvent::FilterID> Dependency; // (module ID, filter) read by a fill function
+
+    virtual ~TCAVirtualHistogram() = default;
+
+    // Bind a filler to the calling thread's replica, call once per worker thread. Histograms that can defer their fills
+    // (TCAFillTarget) hand them to the thread's buffer when one is given. Empty if there is nothing to fill per event
+    virtual Filler MakeFiller(TCAFillBuffer* buffer = nullptr) = 0;
+    // As above for a whole event block, empty if the histogram is only filled per event
+    virtual BlockFiller MakeBlockFiller(TCAFillBuffer* buffer = nullptr) = 0;
+    // Add the merged contents of another histogram of the same type and binning, which is consumed by the merge
+    virtual void Accumulate(TCAVirtualHistogram& other) = 0;
+    // Merge the per-thread replicas ahead of Write(), pairwise on up to nThreads threads
+    virtual void MergeReplicas(unsigned int nThreads = 1) = 0;
+    // The merged histogram as Write() writes it, a ROOT object that outlives this histogram, nullptr if there is nothing
+    // to write. Native histograms convert without joining a directory, so several threads can convert at once
+    virtual std::shared_ptr<TObject> GetOutput() = 0;
+    // Bins of one replica including under- and overflow, what merging two replicas walks through
+    virtual size_t GetNcells() const { return 0; }
+    // Bind a publisher to the calling thread's replica, which only that thread may call while it fills
+    virtual Publisher MakePublisher() = 0;
+    // Write the sum of the copies last published by each thread, if any, while the replicas are still being filled
+    virtual Int_t WriteSnapshot() = 0;
+    virtual void ClearSnapshots() = 0; // Drop the published copies, the publishers made so far must not be called again
 
+    // Event data read by the fill functions, the sort only reads the branches some histogram depends on
+    inline void AddDependency(size_t moduleID, TCAEvent::FilterID filterID) { fDependencies.set(TCAEvent::GetColumn(moduleID, filterID)); }
+    inline void AddDependencies(std::initializer_list<Dependency> dependencies)
+    {
+        for (const auto& [moduleID, filterID] : dependencies)
+            AddDependency(moduleID, filterID);
+    }
+    inline bool HasDependencies() const { return fDependencies.any(); }
+    // Histograms that declare nothing are assumed to read every branch
+    inline TCAEvent::ColumnMask GetDependencies() const { return HasDependencies() ? fDependencies : TCAEvent::ColumnMask().set(); }
+
+protected:
+    TCAEvent::ColumnMask fDependencies; // Declared (module, filter) columns, see AddDependency()
+};
+
+// T is a ROOT histogram (TH1D, TH2F, ...) or a native one (TCAFlatH1I, TCATiledH2I, ...), fill functions use the same calls for both
 template <typename T>
-class TCAHistogram : public TNamed
+class TCAHistogram : public TCAVirtualHistogram
 {
 public:
     template <typename... Args>
     explicit TCAHistogram(Args&&... args)
-        : fHistogram(ROOT::TThreadedObject<T>(std::forward<Args>(args)...))
+        : fHistogram(std::forward<Args>(args)...)
     {
         if (!ROOT::IsImplicitMTEnabled())
         {
@@ -28,23 +101,214 @@ public:
 
         fName = fHistogram.Get()->GetName();
         fTitle = fHistogram.Get()->GetTitle();
+        fNcells = fHistogram.Get()->GetNcells();
     }
     virtual ~TCAHistogram() = default;
 
+    size_t GetNcells() const override { return fNcells; }
+
     template <typename... Args>
-    inline void Fill(Args&&... args) { fFillFunction(std::forward<Args>(args)...); }
+    inline void Fill(Args&&... args)
+    {
+        if (fFillFunction)
+            fFillFunction(std::forward<Args>(args)...);
+    }
 
-    void SetFillFunction(const std::function<void(std::shared_ptr<T>, TCAEvent* event)>& func) { fFillFunction = func; }
+    // Dependencies list the (module ID, filter) pairs the function reads, see TCAVirtualHistogram::AddDependency()
+    void SetFillFunction(const std::function<void(std::shared_ptr<T>, TCAEvent* event)>& func, std::initializer_list<Dependency> dependencies = {})
+    {
+        fFillFunction = func;
+        AddDependencies(dependencies);
+    }
+    void SetBlockFillFunction(const std::function<void(std::shared_ptr<T>, const TCAEventBlock& block)>& func, std::initializer_list<Dependency> dependencies = {})
+    {
+        fBlockFillFunction = func;
+        AddDependencies(dependencies);
+    }
 
     auto GetPtr() { return fHistogram.Get(); }
     auto GetRawPtr() { return fHistogram.Get().get(); }
     auto GetThreadLocalPtr() { return fHistogram.Get(); }
-    auto Merge() { return fHistogram.Merge(); }
-    auto Write() { return this->Merge()->Write(); }
+    std::shared_ptr<T> Merge()
+    {
+        MergeReplicas();
+        if constexpr (std::is_base_of_v<TCAFillTarget, T>)
+            return fHistogram.Merge(); // Already folded, returns right away
+        else
+            return fMerged;
+    }
+    Int_t Write(const char* name = nullptr, Int_t option = 0, Int_t bufsize = 0) override { return this->Merge()->Write(name, option, bufsize); }
+    std::shared_ptr<TObject> GetOutput() override
+    {
+        if constexpr (std::is_base_of_v<TCAFillTarget, T>)
+        {
+            auto merged = Merge();
+            TDirectory::TContext context(nullptr);
+            return merged->ToROOT();
+        }
+        else
+            return Merge();
+    }
+
+    Filler MakeFiller(TCAFillBuffer* buffer = nullptr) override
+    {
+        if (!fFillFunction) // Filled by someone else, e.g. a TCAHistogramFamily
+            return Filler();
+        auto threadLocalHist = GetReplica(buffer);
+        return [this, threadLocalHist](TCAEvent* event) { fFillFunction(threadLocalHist, event); };
+    }
+    BlockFiller MakeBlockFiller(TCAFillBuffer* buffer = nullptr) override
+    {
+        if (!fBlockFillFunction)
+            return BlockFiller();
+        auto threadLocalHist = GetReplica(buffer);
+        return [this, threadLocalHist](const TCAEventBlock& block) { fBlockFillFunction(threadLocalHist, block); };
+    }
+    void MergeReplicas(unsigned int nThreads = 1) override
+    {
+        if constexpr (std::is_base_of_v<TCAFillTarget, T>)
+            fHistogram.Merge(nThreads);
+        else if (!fMerged) // ROOT merges once, later calls only return the first result
+        {
+            fMerged = fHistogram.Merge([nThreads](std::shared_ptr<T> target, std::vector<std::shared_ptr<T>>& replicas)
+                                       {
+                // Replicas are clones with identical binning, so pairwise Add() replaces TH1::Merge() and its axis checks
+                std::vector<T*> objects = {target.get()};
+                for (const auto& replica : replicas)
+                {
+                    if (replica && replica != target)
+                        objects.push_back(replica.get());
+                }
+                CAUtilities::TreeReduce(objects, nThreads); });
+        }
+    }
+    Publisher MakePublisher() override
+    {
+        auto threadLocalHist = fHistogram.Get();
+        size_t index = 0;
+        {
+            std::lock_guard<std::mutex> lock(fSnapshotMutex);
+            index = fSnapshots.size();
+            fSnapshots.emplace_back();
+        }
+        return [this, threadLocalHist, index]()
+        {
+            auto copy = Copy(*threadLocalHist); // Outside the lock, only the pointer swap is guarded
+            std::lock_guard<std::mutex> lock(fSnapshotMutex);
+            fSnapshots[index] = std::move(copy); // A snapshot being written keeps its own reference to the old copy
+        };
+    }
+    Int_t WriteSnapshot() override
+    {
+        std::vector<std::shared_ptr<T>> snapshots;
+        {
+            std::lock_guard<std::mutex> lock(fSnapshotMutex);
+            snapshots = fSnapshots;
+        }
+        std::shared_ptr<T> sum;
+        for (const auto& snapshot : snapshots)
+        {
+            if (!snapshot)
+                continue;
+            if (sum)
+                sum->Add(snapshot.get());
+            else
+                sum = Copy(*snapshot);
+        }
+        return sum ? sum->Write() : 0;
+    }
+    void ClearSnapshots() override
+    {
+        std::lock_guard<std::mutex> lock(fSnapshotMutex);
+        fSnapshots.clear();
+    }
+    void Accumulate(TCAVirtualHistogram& other) override
+    {
+        auto otherHist = dynamic_cast<TCAHistogram<T>*>(&other);
+        if (otherHist == nullptr)
+        {
+            throw std::runtime_error(Form("[ERROR] Cannot accumulate histogram %s into %s of a different type", other.GetName(), GetName()));
+        }
+        fHistogram.Get()->Add(otherHist->Merge().get()); // Lands in the calling thread's replica, merged with the rest on Write()
+    }
+
+protected:
+    std::shared_ptr<T> GetReplica(TCAFillBuffer* buffer) // The calling thread's replica, filling through buffer if it can
+    {
+        auto threadLocalHist = fHistogram.Get();
+        if constexpr (std::is_base_of_v<TCAFillTarget, T>)
+            threadLocalHist->SetFillBuffer(buffer);
+        return threadLocalHist;
+    }
+    static std::shared_ptr<T> Copy(const T& hist)
+    {
+        if constexpr (std::is_base_of_v<TCAFillTarget, T>)
+            return std::make_shared<T>(hist);
+        else
+        {
+            TDirectory::TContext context(nullptr); // Copied ROOT histograms would otherwise join the thread's current directory
+            return std::make_shared<T>(hist);
+        }
+    }
+
+    typename TCAHistogramReplicas<T>::Type fHistogram;
+    size_t fNcells = 0;         // Of every replica, the binning is fixed at construction
+    std::shared_ptr<T> fMerged; // Result of the one merge ROOT replicas allow, unused for native histograms
+    std::mutex fSnapshotMutex;                  // Guards fSnapshots, held for a pointer swap or copy only
+    std::vector<std::shared_ptr<T>> fSnapshots; // Copy last published by each publisher, replaced as a whole
+    std::function<void(std::shared_ptr<T>, TCAEvent* event)> fFillFunction;                  // Empty until set, histograms without one get no filler
+    std::function<void(std::shared_ptr<T>, const TCAEventBlock& block)> fBlockFillFunction; // Replaces fFillFunction in batched sorts when set
+};
+
+// TCAHistogram with its fill functions as template parameters rather than std::function. The fillers call them with the
+// thread's replica by reference, so the fill body is inlined into the filler and no shared_ptr is copied per event, which
+// at 20 threads means no atomic reference count traffic. FillFunc is called as func(T& hist, TCAEvent* event) and
+// BlockFillFunc as func(T& hist, const TCAEventBlock& block); std::nullptr_t stands for no function. Without a
+// BlockFillFunc, batched sorts get a block filler looping FillFunc over the block's entries, so the per-event
+// std::function call is saved there too. Use TCAHistogramOwner::AddStaticHistogram() to have the lambda types deduced.
+template <typename T, typename FillFunc, typename BlockFillFunc = std::nullptr_t>
+class TCAStaticHistogram : public TCAHistogram<T>
+{
+public:
+    static_assert(!std::is_null_pointer_v<FillFunc> || !std::is_null_pointer_v<BlockFillFunc>, "A static histogram needs a fill or a block fill function");
+
+    template <typename... Args>
+    TCAStaticHistogram(FillFunc fillFunc, BlockFillFunc blockFillFunc, std::initializer_list<TCAVirtualHistogram::Dependency> dependencies, Args&&... args)
+        : TCAHistogram<T>(std::forward<Args>(args)...), fStaticFillFunction(std::move(fillFunc)), fStaticBlockFillFunction(std::move(blockFillFunc))
+    {
+        this->AddDependencies(dependencies);
+    }
+
+    TCAVirtualHistogram::Filler MakeFiller(TCAFillBuffer* buffer = nullptr) override
+    {
+        if constexpr (std::is_null_pointer_v<FillFunc>)
+            return TCAVirtualHistogram::Filler();
+        else
+            return [func = fStaticFillFunction, threadLocalHist = this->GetReplica(buffer)](TCAEvent* event) { func(*threadLocalHist, event); };
+    }
+    TCAVirtualHistogram::BlockFiller MakeBlockFiller(TCAFillBuffer* buffer = nullptr) override
+    {
+        if constexpr (!std::is_null_pointer_v<BlockFillFunc>)
+            return [func = fStaticBlockFillFunction, threadLocalHist = this->GetReplica(buffer)](const TCAEventBlock& block) { func(*threadLocalHist, block); };
+        else
+        {
+            // The event is only a view of the block, bound anew for every block
+            return [func = fStaticFillFunction, threadLocalHist = this->GetReplica(buffer), event = std::make_shared<TCAEvent>(nullptr)](const TCAEventBlock& block)
+            {
+                event->SetBlock(&block);
+                for (size_t entry = 0; entry < block.GetEntries(); entry++)
+                {
+                    event->SetBlockEntry(entry);
+                    func(*threadLocalHist, event.get());
+                }
+                event->SetBlock(nullptr);
+            };
+        }
+    }
 
 protected:
-    ROOT::TThreadedObject<T> fHistogram;
-    std::function<void(std::shared_ptr<T>, TCAEvent* event)> fFillFunction = [this](std::shared_ptr<T> thisHist, TCAEvent* event) {}; // Default does nothing
+    FillFunc fStaticFillFunction;
+    BlockFillFunc fStaticBlockFillFunction;
 };
 
 #endif // TCAHISTOGRAM_HPP
\ No newline at end of file
@@ -0,0 +1,147 @@
+#ifndef TCAHISTOGRAMFAMILY_HPP
+#define TCAHISTOGRAMFAMILY_HPP
+
+// Standard C++ includes
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+#include "TCAHistogram.hpp"
+
+// One histogram per channel or detector, all filled from the same filter with the same binning, as expanded from a
+// histogram specification file (see CAHistogramSpec). The members are plain TCAHistogram<H> on their owners, so they
+// are merged, written and snapshotted like any other histogram, but have no fill functions of their own: the family,
+// owned by the experiment, fills all of them from one compact table per module in one loop, rather than one closure
+// per histogram. H is a native 1D histogram (TCAFlatH1I, ...).
+template <typename H>
+class TCAHistogramFamily : public TCAVirtualHistogram
+{
+public:
+    static_assert(std::is_base_of_v<TCAFillTarget, H>, "Histogram families fill native histograms only");
+
+    // One channel feeding one member, value = gain * x + offset
+    struct Row
+    {
+        uint32_t fChannel;
+        uint32_t fMember; // Index into fMembers
+        double fOffset;
+        double fGain;
+    };
+
+    // Constructors
+    TCAHistogramFamily(const char* name, const char* title, TCAEvent::FilterID filterID)
+        : fFilterID(filterID)
+    {
+        fName = name;
+        fTitle = title;
+    }
+    virtual ~TCAHistogramFamily() = default;
+
+    // Getters
+    inline size_t GetMemberCount() const { return fMembers.size(); }
+    inline TCAEvent::FilterID GetFilterID() const { return fFilterID; }
+
+    // Methods
+    size_t AddMember(TCAHistogram<H>* member) // Owned by its channel or detector, which must outlive the family
+    {
+        fMembers.push_back(member);
+        return fMembers.size() - 1;
+    }
+    void AddRow(size_t moduleID, size_t channel, size_t member, double offset = 0.0, double gain = 1.0)
+    {
+        auto table = fTables.begin();
+        while (table != fTables.end() && table->fModuleID != moduleID)
+            ++table;
+        if (table == fTables.end())
+        {
+            fTables.push_back({moduleID, {}});
+            table = fTables.end() - 1;
+            AddDependency(moduleID, fFilterID);
+        }
+        table->fRows.push_back({static_cast<uint32_t>(channel), static_cast<uint32_t>(member), offset, gain});
+        fMembers.at(member)->AddDependency(moduleID, fFilterID);
+    }
+
+    Filler MakeFiller(TCAFillBuffer* buffer = nullptr) override
+    {
+        return [this, replicas = GetReplicas(buffer)](TCAEvent* event)
+        {
+            for (const auto& table : fTables)
+            {
+                if (!event->HasData(table.fModuleID, fFilterID))
+                    continue;
+                for (const auto& row : table.fRows)
+                {
+                    const double value = (*event)(table.fModuleID, fFilterID, row.fChannel);
+                    if (value > 0) // Empty channels are exported as NaN or 0
+                        replicas[row.fMember]->Fill(row.fGain * value + row.fOffset);
+                }
+            }
+        };
+    }
+    BlockFiller MakeBlockFiller(TCAFillBuffer* buffer = nullptr) override
+    {
+        return [this, replicas = GetReplicas(buffer)](const TCAEventBlock& block)
+        {
+            for (const auto& table : fTables)
+            {
+                const auto column = block.View(table.fModuleID, fFilterID);
+                if (!column.IsValid())
+                    continue;
+                // Row by row, each member's bins stay in cache for the whole block
+                for (const auto& row : table.fRows)
+                {
+                    if (row.fChannel >= column.GetWidth())
+                        continue;
+                    H& hist = *replicas[row.fMember];
+                    for (size_t entry = 0; entry < column.GetEntries(); entry++)
+                    {
+                        const double value = column(entry, row.fChannel);
+                        if (value > 0)
+                            hist.Fill(row.fGain * value + row.fOffset);
+                    }
+                }
+            }
+        };
+    }
+
+    // The members merge, write and snapshot themselves
+    void Accumulate(TCAVirtualHistogram&) override {}
+    void MergeReplicas(unsigned int = 1) override {}
+    std::shared_ptr<TObject> GetOutput() override { return nullptr; }
+    Publisher MakePublisher() override { return []() {}; }
+    Int_t WriteSnapshot() override { return 0; }
+    void ClearSnapshots() override {}
+    Int_t Write(const char* = nullptr, Int_t = 0, Int_t = 0) override { return 0; }
+
+protected:
+    struct ModuleTable
+    {
+        size_t fModuleID;
+        std::vector<Row> fRows;
+    };
+
+    std::vector<std::shared_ptr<H>> GetReplicas(TCAFillBuffer* buffer) // The calling thread's replica of every member
+    {
+        std::vector<std::shared_ptr<H>> replicas;
+        replicas.reserve(fMembers.size());
+        for (auto member : fMembers)
+        {
+            replicas.push_back(member->GetThreadLocalPtr());
+            replicas.back()->SetFillBuffer(buffer);
+        }
+        return replicas;
+    }
+
+    TCAEvent::FilterID fFilterID;
+    std::vector<TCAHistogram<H>*> fMembers; // Filled through the tables, owned by their channels and detectors
+    std::vector<ModuleTable> fTables;       // Rows grouped by module, one column view per module and block
+};
+
+#endif // TCAHISTOGRAMFAMILY_HPP
@@ -2,6 +2,9 @@
 #define TCAHISTOGRAMOWNER_HPP
 
 // Standard C++ includes
+#include <initializer_list>
+#include <utility>
+#include <vector>
 
 // ROOT includes
 #include <TH1.h>
@@ -9,6 +12,7 @@
 #include <TObjArray.h>
 
 // Project includes
+#include "TCAHistogram.hpp"
 
 class TCAHistogramOwner : public TNamed
 {
@@ -33,11 +37,25 @@ public:
     // std::vector<std::shared_ptr<TH1>> CreateThreadLocalPtrs();
 
     template <typename T, typename... Args>
-    void AddHistogram(Args&&... args)
+    T* AddHistogram(Args&&... args)
     {
         auto hist = new T(std::forward<Args>(args)...);
         fHistograms.Add(hist);
+        return hist;
     }
+    // TCAStaticHistogram<T> with the types of the fill functions deduced, pass nullptr for a function the histogram lacks
+    template <typename T, typename FillFunc, typename BlockFillFunc, typename... Args>
+    TCAStaticHistogram<T, FillFunc, BlockFillFunc>* AddStaticHistogram(FillFunc fillFunc, BlockFillFunc blockFillFunc, std::initializer_list<TCAVirtualHistogram::Dependency> dependencies, Args&&... args)
+    {
+        return AddHistogram<TCAStaticHistogram<T, FillFunc, BlockFillFunc>>(std::move(fillFunc), std::move(blockFillFunc), dependencies, std::forward<Args>(args)...);
+    }
+
+    void AppendFillers(std::vector<TCAVirtualHistogram::Filler>& fillers, std::vector<TCAVirtualHistogram::BlockFiller>& blockFillers, TCAFillBuffer* buffer = nullptr, bool readsBlocks = true); // Block fillers preferred when reading blocks
+    void AppendDependencies(TCAEvent::ColumnMask& columns) const; // Adds the columns read by the owned histograms
+    void AppendHistograms(std::vector<TCAVirtualHistogram*>& histograms) const;
+    void AccumulateHistograms(TCAHistogramOwner& other);          // Adds other's histograms to ours, both must hold the same histograms
+    void WriteHistograms();
+    void WriteSnapshots(); // As WriteHistograms() from the copies published for the snapshots, see TCASnapshotWriter
 
     // virtual void PrintInfo() const;
 
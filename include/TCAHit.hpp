@@ -0,0 +1,49 @@
+#ifndef TCAHIT_HPP
+#define TCAHIT_HPP
+
+// Standard C++ includes
+#include <cstddef>
+#include <cstdint>
+
+// ROOT includes
+
+// Project includes
+
+// One channel above threshold in one event, collected once when an event block is decoded
+struct TCAHit
+{
+    enum Flag : uint16_t
+    {
+        kPileUp = 1 << 0, // Module flagged the hit as piled up
+        kNoTime = 1 << 1  // No channel time was recorded, fTime is NaN
+    };
+
+    uint16_t fModuleID = 0;
+    uint8_t fChannel = 0;
+    uint16_t fFlags = 0;
+    double fAmplitude = 0; // Amplitude (SCP) or long integral (QDC)
+    double fTime = 0;      // Channel time
+
+    inline bool HasFlag(Flag flag) const { return (fFlags & flag) != 0; }
+};
+
+// Hits of one event, in module then channel order
+class TCAHitView
+{
+public:
+    TCAHitView() = default;
+    TCAHitView(const TCAHit* data, size_t size) : fData(data), fSize(size) {}
+
+    inline const TCAHit* data() const { return fData; }
+    inline size_t size() const { return fSize; }
+    inline bool empty() const { return fSize == 0; }
+    inline const TCAHit* begin() const { return fData; }
+    inline const TCAHit* end() const { return fData + fSize; }
+    inline const TCAHit& operator[](size_t idx) const { return fData[idx]; }
+
+private:
+    const TCAHit* fData = nullptr;
+    size_t fSize = 0;
+};
+
+#endif // TCAHIT_HPP
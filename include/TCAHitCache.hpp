@@ -0,0 +1,120 @@
+#ifndef TCAHITCACHE_HPP
+#define TCAHITCACHE_HPP
+
+// Standard C++ includes
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ROOT includes
+#include <Compression.h>
+
+// Project includes
+#include "TCAEventBlock.hpp"
+
+// Compact on-disk copy of a run for repeated re-sorts. Each event block is stored as one independently compressed block:
+// per column, a bit mask of the filled values of each entry followed by the values as zigzag varints. Module timestamps
+// are delta-encoded and pile-up values reduced to flag bits. Values are stored as integers, the MDPP-16 data are 16 bit
+// integers and the fractional dither MVME may add on export is dropped. A block index at the end of the file lets any
+// thread decode any block on its own.
+namespace CAHitCache
+{
+    static constexpr char kMagic[4] = {'C', 'A', 'H', 'C'};
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kMaxZipChunk = 0xffffff; // Largest buffer ROOT compresses in one go
+    static constexpr size_t kSourceNameLength = 256;
+
+    struct FileHeader
+    {
+        char fMagic[4];
+        uint32_t fVersion;
+        uint32_t fAlgorithm;                         // ROOT::RCompressionSetting::EAlgorithm of the blocks
+        uint32_t fBlockSize;                         // Entries in the largest block, blocks end early at work-unit boundaries
+        uint64_t fEntries;                           // Entries in the cache
+        uint64_t fNBlocks;                           // Blocks in the index
+        uint64_t fIndexOffset;                       // Byte offset of the block index
+        uint32_t fWidths[TCAEventBlock::kNColumns]; // Values per entry of each column, 0 for absent columns
+        char fSourceName[kSourceNameLength];         // Base name of the run the cache was made from
+    };
+
+    struct BlockInfo
+    {
+        uint64_t fOffset;     // Byte offset of the stored block
+        uint64_t fFirstEntry; // First entry of the block
+        uint32_t fEntries;    // Entries in the block
+        uint32_t fStoredSize; // Bytes on disk
+        uint32_t fRawSize;    // Bytes after decompression, equal to fStoredSize for blocks stored uncompressed
+        uint32_t fPadding;
+    };
+
+    std::string GetSourceName(const std::string& runFileName);
+
+    // Compress raw in ROOT zip chunks, false if the data do not compress and should be stored as is
+    bool Compress(std::vector<unsigned char>& raw, std::vector<unsigned char>& out, ROOT::RCompressionSetting::EAlgorithm::EValues algorithm, int level);
+    void Decompress(const unsigned char* src, size_t srcSize, unsigned char* tgt, size_t tgtSize); // Throws on corrupt data
+
+} // namespace CAHitCache
+
+class TCAHitCacheWriter
+{
+public:
+    static inline constexpr int kDefaultLevel = 5;
+
+    // Constructors
+    TCAHitCacheWriter() = delete;
+    TCAHitCacheWriter(const TCAHitCacheWriter&) = delete;
+    TCAHitCacheWriter(const std::string& fileName, const std::string& runFileName,
+                      ROOT::RCompressionSetting::EAlgorithm::EValues algorithm = ROOT::RCompressionSetting::EAlgorithm::kZSTD, int level = kDefaultLevel);
+
+    // Destructor
+    ~TCAHitCacheWriter();
+
+    // Methods
+    void WriteBlock(const TCAEventBlock& block); // Thread-safe, blocks may arrive in any order but must share one layout
+    void Close();                                // Write the block index and header, the cache is only valid afterwards
+
+private:
+    std::string fFileName;
+    FILE* fFile = nullptr;
+    CAHitCache::FileHeader fHeader{};
+    int fLevel;
+    bool fHasLayout = false; // Column widths taken from the first block
+    std::mutex fMutex;       // Guards everything below the header
+    std::vector<CAHitCache::BlockInfo> fIndex;
+    uint64_t fOffset = 0; // Current end of the file
+};
+
+class TCAHitCacheReader : public TCAVirtualBlockSource
+{
+public:
+    // Constructors
+    TCAHitCacheReader() = delete;
+    TCAHitCacheReader(const TCAHitCacheReader&) = delete;
+    TCAHitCacheReader(const std::string& fileName);
+
+    // Destructor
+    virtual ~TCAHitCacheReader();
+
+    // Getters
+    inline const std::string& GetFileName() const { return fFileName; }
+    inline const char* GetSourceName() const { return fHeader.fSourceName; }
+    inline size_t GetBlockCount() const { return fIndex.size(); }
+    inline Long64_t GetEntries() const override { return static_cast<Long64_t>(fHeader.fEntries); }
+    inline size_t GetNaturalBlockSize() const override { return fHeader.fBlockSize; }
+    std::array<size_t, TCAEventBlock::kNColumns> GetColumnWidths() const override;
+
+    // Methods
+    size_t Read(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry) const override;
+
+private:
+    std::string fFileName;
+    CAHitCache::FileHeader fHeader{};
+    std::vector<CAHitCache::BlockInfo> fIndex; // Sorted by first entry
+    const unsigned char* fData = nullptr;
+    size_t fMapSize = 0;
+};
+
+#endif // TCAHITCACHE_HPP
@@ -0,0 +1,93 @@
+#ifndef TCALISTFILEREADER_HPP
+#define TCALISTFILEREADER_HPP
+
+// Standard C++ includes
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "TCAEventBlock.hpp"
+
+// Memory-mapped reader for MVME VME listfiles (.mvmelst, listfile format version 1). Events are decoded straight into the
+// module/filter layout of TCAEventBlock, so runs can be sorted without first converting them to a ROOT tree.
+class TCAListfileReader : public TCAVirtualBlockSource
+{
+public:
+    // Listfile format version 1
+    static inline constexpr uint32_t kVersion = 1;
+    static inline constexpr size_t kPreambleWords = 2; // "MVME" magic and format version
+    static inline constexpr uint32_t kSectionTypeMask = 0xe0000000;
+    static inline constexpr int kSectionTypeShift = 29;
+    static inline constexpr uint32_t kSectionSizeMask = 0x0000ffff;
+    static inline constexpr uint32_t kEventIndexMask = 0x1e000000;
+    static inline constexpr int kEventIndexShift = 25;
+    static inline constexpr uint32_t kModuleTypeMask = 0xff000000;
+    static inline constexpr int kModuleTypeShift = 24;
+    static inline constexpr uint32_t kModuleSizeMask = 0x000fffff;
+    static inline constexpr uint32_t kEndMarker = 0x87654321; // Closes each module readout and each event section
+
+    // Module type byte of the module headers, the typeId of MVME's module templates
+    static inline constexpr uint32_t kMDPP16SCPType = 4;
+    static inline constexpr uint32_t kMDPP16QDCType = 8;
+
+    enum SectionType
+    {
+        kConfigSection = 0,
+        kEventSection = 1,
+        kEndOfFileSection = 2,
+        kTimetickSection = 3,
+        kPauseSection = 4
+    };
+
+    // MDPP-16 data words
+    static inline constexpr uint32_t kHeaderMask = 0xc0000000;
+    static inline constexpr uint32_t kHeaderWord = 0x40000000;
+    static inline constexpr uint32_t kEndOfEventWord = 0xc0000000; // Carries the low 30 bits of the module timestamp
+    static inline constexpr uint32_t kDataMask = 0xf0000000;
+    static inline constexpr uint32_t kDataWord = 0x10000000;
+    static inline constexpr uint32_t kExtendedTimestampWord = 0x20000000; // Carries timestamp bits 30-45
+    static inline constexpr int kAddressShift = 16;
+    static inline constexpr uint32_t kAddressMask = 0x3f;
+    static inline constexpr uint32_t kValueMask = 0xffff;
+    static inline constexpr uint32_t kPileUpBit = 1U << 23;
+    static inline constexpr uint32_t kTimestampMask = 0x3fffffff;
+
+    // Constructors
+    TCAListfileReader() = delete;
+    TCAListfileReader(const TCAListfileReader&) = delete;
+    TCAListfileReader(const std::string& fileName, unsigned int eventIndex = 0);
+
+    // Destructor
+    virtual ~TCAListfileReader();
+
+    // Getters
+    inline const std::string& GetFileName() const { return fFileName; }
+    inline Long64_t GetEntries() const override { return static_cast<Long64_t>(fEventOffsets.size()); }
+    std::array<size_t, TCAEventBlock::kNColumns> GetColumnWidths() const override;
+
+    // Methods
+    size_t Read(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry) const override;
+    static bool IsListfile(const std::string& fileName);
+
+private:
+    void BuildIndex();
+    void DecodeEvent(size_t offset, TCAEventBlock& block, size_t row) const;
+    void DecodeModule(size_t moduleID, const uint32_t* words, size_t nWords, TCAEventBlock& block, size_t row) const;
+
+    static bool IsQDC(size_t moduleID);             // Module runs the MDPP-16 QDC rather than the SCP firmware
+    static uint32_t GetModuleType(size_t moduleID); // Type byte expected in the headers of the module's readouts
+
+    std::string fFileName;
+    unsigned int fEventIndex;                               // VME event (readout trigger) whose sections are sorted
+    std::array<uint32_t, TCAEvent::kNModules> fModuleTypes; // Type byte of each module, see GetModuleType()
+    const uint32_t* fWords = nullptr;                       // Mapped listfile
+    size_t fNWords = 0;                                     // Size of the mapping in 32-bit words
+    size_t fMapSize = 0;                                    // Size of the mapping in bytes
+    std::vector<size_t> fEventOffsets;                      // Word offset of each event section header, indexed by entry
+};
+
+#endif // TCALISTFILEREADER_HPP
@@ -0,0 +1,69 @@
+#ifndef TCAOUTPUTWRITER_HPP
+#define TCAOUTPUTWRITER_HPP
+
+// Standard C++ includes
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// ROOT includes
+#include <TObject.h>
+
+// Project includes
+#include "TCABoundedQueue.hpp"
+
+// Forward declarations
+class TDirectory;
+
+// Writes output files of merged histograms on background threads, so the run sorter starts the next run while the
+// previous run's output is still being compressed. Each file is written by one thread, files of different runs are
+// compressed side by side. Outputs are queued as ready-made ROOT objects (see TCAVirtualHistogram::GetOutput()), they do
+// not refer back to the experiment that made them, which can be released as soon as its output is submitted.
+class TCAOutputWriter
+{
+public:
+    // One object and the directory it goes to, a path such as "clover_cross/clover_cross_ch00", "" for the top directory
+    struct Item
+    {
+        std::string fDirectory;
+        std::shared_ptr<TObject> fObject;
+    };
+    typedef std::vector<Item> Items;
+    typedef std::map<std::string, TDirectory*> DirectoryMap; // Directories made so far in one file, by path
+
+    static inline constexpr size_t kMaxPendingPerThread = 1; // Outputs queued per thread, Submit() waits beyond
+
+    // Constructors
+    TCAOutputWriter() = delete;
+    TCAOutputWriter(const TCAOutputWriter&) = delete;
+    explicit TCAOutputWriter(unsigned int nThreads);
+
+    // Destructor
+    ~TCAOutputWriter(); // Writes everything submitted before returning
+
+    // Methods
+    void Submit(const std::string& fileName, Items items); // Waits while too many outputs are queued
+    size_t Wait();                                         // Until every submitted output is written, returns the number that failed since the last call
+
+    static void Write(const std::string& fileName, const Items& items); // On the calling thread, throws if the file cannot be written
+    static TDirectory* GetDirectory(TDirectory* top, const std::string& path, DirectoryMap& directories); // Made on first use
+
+private:
+    typedef std::pair<std::string, Items> Output;
+
+    void Run();
+
+    TCABoundedQueue<Output> fQueue;
+    std::vector<std::thread> fThreads;
+    std::mutex fMutex;
+    std::condition_variable fWrittenCondition; // Signalled when an output is written or failed
+    size_t fPending = 0;                       // Submitted and not yet written, guarded by fMutex
+    size_t fFailed = 0;                        // Guarded by fMutex
+};
+
+#endif // TCAOUTPUTWRITER_HPP
@@ -0,0 +1,77 @@
+#ifndef TCARUNSORTER_HPP
+#define TCARUNSORTER_HPP
+
+// Standard C++ includes
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "TCAExperiment.hpp"
+#include "TCAOutputWriter.hpp"
+
+// Sorts a list of runs side by side, each in its own TCAExperiment with its own share of the threads. An opener thread
+// builds and opens the next run while the others sort, so a run slot that frees up starts on a run that is already open.
+// Output is written per run by a background TCAOutputWriter, so a slot moves on to its next run while the last one is
+// written, or summed into one experiment that is never sorted itself.
+class TCARunSorter
+{
+public:
+    // Builds the experiment of one run with its histograms and per-run settings (gain shifts, hit cache), not yet opened
+    typedef std::function<std::unique_ptr<TCAExperiment>(int runNumber)> ExperimentFactory;
+
+    static inline constexpr size_t kOpenAhead = 1; // Opened runs kept waiting for a free run slot
+
+    // Constructors
+    TCARunSorter() = delete;
+    TCARunSorter(const TCARunSorter&) = delete;
+    TCARunSorter(const std::vector<int>& runNumbers, const ExperimentFactory& factory);
+
+    // Setters
+    inline void SetRunFileName(const std::string& runFileName) { fRunFileName = runFileName; }          // See CAUtilities::GetRunFileName()
+    inline void SetOutputFileName(const std::string& outputFileName) { fOutputFileName = outputFileName; } // Summed output, or pattern of per-run outputs
+    inline void SetSumRuns(bool sumRuns) { fSumRuns = sumRuns; }
+    inline void SetConcurrentRuns(unsigned int concurrentRuns) { fConcurrentRuns = std::max(1U, concurrentRuns); }
+
+    // Methods
+    size_t Sort(); // Sorts and writes all runs, returns the number of runs that failed
+
+private:
+    struct OpenedRun
+    {
+        int fRunNumber = 0;
+        std::unique_ptr<TCAExperiment> fExperiment; // nullptr if the run could not be opened
+    };
+
+    void OpenRuns();
+    void SortRuns();
+    bool NextRun(OpenedRun& run); // Blocks until the opener hands over a run, false once all runs are taken
+
+    std::vector<int> fRunNumbers;
+    ExperimentFactory fFactory;
+    std::string fRunFileName;
+    std::string fOutputFileName;
+    bool fSumRuns = false;
+    unsigned int fConcurrentRuns = 2;
+    unsigned int fRunThreads = 1; // Worker threads of each run, the machine is split between the run slots
+
+    std::mutex fMutex;
+    std::condition_variable fOpenedCondition; // Signalled when a run is opened or the opener is done
+    std::condition_variable fTakenCondition;  // Signalled when a run slot takes an opened run
+    std::deque<OpenedRun> fOpened;            // Opened runs waiting for a run slot
+    bool fOpenerDone = false;
+
+    std::unique_ptr<TCAOutputWriter> fOutputWriter; // Writes the per-run outputs, one thread per run slot
+
+    std::mutex fSumMutex;
+    std::unique_ptr<TCAExperiment> fSum; // Accumulates the histograms of all runs when summing
+    size_t fFailedRuns = 0;              // Guarded by fSumMutex
+};
+
+#endif // TCARUNSORTER_HPP
@@ -0,0 +1,97 @@
+#ifndef TCASNAPSHOTWRITER_HPP
+#define TCASNAPSHOTWRITER_HPP
+
+// Standard C++ includes
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "TCAHistogram.hpp"
+
+// Forward declarations
+class TCAExperiment;
+class TCAFillBuffer;
+
+// Writes snapshots of the histograms while a sort runs, every so many seconds or entries. No thread ever reads a
+// replica another thread fills: a snapshot request is an epoch counter that each worker checks between two blocks,
+// copying its own replicas and publishing the copies when the epoch moved. Once every worker has published, the writer
+// thread sums the copies and replaces the snapshot file. Workers never wait on each other or on the writer.
+class TCASnapshotWriter
+{
+public:
+    static inline constexpr std::chrono::milliseconds kPollInterval{50}; // Writer checks for due snapshots and published copies
+
+    // Publishes one worker's replicas, made and used on the worker's thread. The last copy is published on destruction,
+    // so declare it after the worker's fill buffer to flush the buffer first
+    class Client
+    {
+    public:
+        // Constructors
+        Client(TCASnapshotWriter& writer, size_t worker, TCAFillBuffer* fillBuffer);
+        Client(const Client&) = delete;
+
+        // Destructor
+        ~Client();
+
+        // Methods
+        inline void Poll() // Call between blocks, publishes if a snapshot was requested since the last call
+        {
+            if (fEpoch < fWriter.fRequested.load(std::memory_order_acquire))
+                Publish();
+        }
+
+    private:
+        void Publish();
+
+        TCASnapshotWriter& fWriter;
+        size_t fWorker;
+        TCAFillBuffer* fFillBuffer; // Flushed before copying, nullptr when filling directly
+        std::vector<TCAVirtualHistogram::Publisher> fPublishers;
+        uint64_t fEpoch = 0; // Last request published for
+    };
+
+    // Constructors
+    TCASnapshotWriter() = delete;
+    TCASnapshotWriter(const TCASnapshotWriter&) = delete;
+    // interval in seconds and entryInterval in processed entries, 0 disables either trigger
+    TCASnapshotWriter(TCAExperiment* experiment, const std::string& fileName, double interval, uint64_t entryInterval, size_t nWorkers, const std::atomic<uint64_t>& processedEntries);
+
+    // Destructor
+    ~TCASnapshotWriter(); // Stops the writer thread, the sort's final histograms are left to WriteOutput()
+
+    // Getters
+    inline size_t GetSnapshotCount() const { return fNSnapshots; }
+
+    // Methods
+    std::unique_ptr<Client> MakeClient(size_t worker, TCAFillBuffer* fillBuffer);
+
+private:
+    void Run();
+    bool IsPublished(uint64_t epoch) const; // Every worker published for epoch or is done
+    void Write();
+
+    TCAExperiment* fExperiment;
+    std::vector<TCAVirtualHistogram*> fHistograms;
+    std::string fFileName;
+    std::chrono::duration<double> fInterval;
+    uint64_t fEntryInterval;
+    const std::atomic<uint64_t>& fProcessedEntries;
+    std::atomic<uint64_t> fRequested = 0;          // Epoch of the latest snapshot request
+    std::vector<std::atomic<uint64_t>> fPublished; // Per worker, the epoch its copies are from, UINT64_MAX once done
+    std::atomic<size_t> fNSnapshots = 0;
+    std::mutex fMutex;
+    std::condition_variable fStopCondition;
+    bool fStop = false; // Guarded by fMutex
+    std::thread fThread;
+};
+
+#endif // TCASNAPSHOTWRITER_HPP
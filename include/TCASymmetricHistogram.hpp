@@ -0,0 +1,501 @@
+#ifndef TCASYMMETRICHISTOGRAM_HPP
+#define TCASYMMETRICHISTOGRAM_HPP
+
+// Standard C++ includes
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ROOT includes
+#include <Compression.h>
+#include <TH2D.h>
+#include <TString.h>
+
+// Project includes
+#include "TCAFillBuffer.hpp"
+#include "TCAFlatHistogram.hpp"
+
+// Gamma-gamma matrices and gamma-gamma-gamma cubes. Coincidences are unordered, so only cells with x <= y (<= z) are
+// stored and each pair or triple is filled once: half the memory and half the fills of a TH2D filled with both
+// orderings, a sixth of a full cube. There are no under- or overflow bins, energies outside [min, max) are dropped.
+// Written out, the matrix is unfolded as if both orderings had been filled, so the diagonal holds twice the pair count
+// and projections count each gamma once per partner, as for the symmetrised TH2D it replaces.
+namespace CASymmetricHistogram
+{
+    static constexpr size_t kM4bChannels = 4096;   // Radware .m4b matrices are 4096 x 4096 32-bit integers, no header
+    static constexpr size_t kM4bRowsPerWrite = 64; // Rows unfolded and written at once, 1 MB
+
+    static constexpr char kCubeMagic[4] = {'C', 'A', 'C', 'B'};
+    static constexpr uint32_t kCubeVersion = 1;
+
+    // CASort cube file: this header, then per allocated brick a BrickHeader and its cells as 32-bit counts, compressed
+    struct CubeHeader
+    {
+        char fMagic[4];
+        uint32_t fVersion;
+        uint32_t fAlgorithm; // ROOT::RCompressionSetting::EAlgorithm of the bricks
+        uint32_t fNBins;     // Bins per axis
+        uint32_t fBrickSide; // Bins per brick side
+        uint32_t fPadding;
+        double fMin;
+        double fMax;
+        uint64_t fNBricks; // Bricks in the file
+        uint64_t fEntries; // Triples filled
+    };
+
+    struct BrickHeader
+    {
+        uint64_t fBrick;      // Index in the tetrahedron of bricks
+        uint32_t fStoredSize; // Bytes on disk
+        uint32_t fRawSize;    // Bytes after decompression, equal to fStoredSize for bricks stored uncompressed
+    };
+
+    // Write a .m4b matrix, getRow fills row (channel) of the unfolded matrix with kM4bChannels counts
+    void WriteM4b(const std::string& fileName, const std::function<void(size_t row, std::vector<uint32_t>& counts)>& getRow);
+
+    FILE* CreateCube(const std::string& fileName, const CubeHeader& header);
+    void WriteBrick(FILE* file, uint64_t brick, std::vector<uint32_t>& cells, uint32_t algorithm);
+    void CloseCube(FILE* file, const std::string& fileName);
+    FILE* OpenCube(const std::string& fileName, CubeHeader& header);
+    void ReadBrick(FILE* file, uint64_t& brick, std::vector<uint32_t>& cells);
+
+    inline uint32_t ToCount(double value) { return static_cast<uint32_t>(std::clamp(value, 0.0, static_cast<double>(std::numeric_limits<uint32_t>::max()))); }
+
+} // namespace CASymmetricHistogram
+
+// Gamma-gamma matrix as the packed triangle x <= y, allocated on the first fill like the flat histograms
+template <typename S>
+class TCASymmetricH2 : public TCAFillTarget
+{
+public:
+    typedef S StorageType;
+
+    // Constructors
+    TCASymmetricH2(const char* name, const char* title, int nBins, double min, double max)
+        : fName(name), fTitle(title), fNBins(nBins), fMin(min), fMax(max), fScale(nBins / (max - min)), fOverflow(nBins + 1.0)
+    {
+        if (nBins <= 0 || !(max > min))
+        {
+            throw std::runtime_error(Form("[ERROR] Histogram %s needs at least one bin and max > min", name));
+        }
+    }
+
+    // Getters
+    inline const char* GetName() const { return fName.c_str(); }
+    inline const char* GetTitle() const { return fTitle.c_str(); }
+    inline int GetNbinsX() const { return fNBins; }
+    inline double GetXmin() const { return fMin; }
+    inline double GetXmax() const { return fMax; }
+    inline size_t GetNcells() const { return Index(fNBins - 1, fNBins - 1) + 1; }
+    inline uint64_t GetEntries() const { return fEntries; }
+    inline bool IsAllocated() const { return !fBins.empty(); }
+    inline size_t GetAllocatedBytes() const { return fBins.size() * sizeof(S); }
+    inline S GetBinContent(size_t binX, size_t binY) const // ROOT bin numbers 1 to nBins in either order, unfolded
+    {
+        if (binX < 1 || binY < 1 || binX > static_cast<size_t>(fNBins) || binY > static_cast<size_t>(fNBins))
+            return S();
+        const S content = GetContent(Index(std::min(binX, binY) - 1, std::max(binX, binY) - 1));
+        return binX == binY ? content + content : content;
+    }
+    inline int FindChannel(double x) const // 0 to nBins - 1, -1 outside the axis
+    {
+        const size_t bin = CAFlatBin(x, fMin, fScale, fOverflow);
+        return bin >= 1 && bin <= static_cast<size_t>(fNBins) ? static_cast<int>(bin - 1) : -1;
+    }
+    static inline size_t Index(size_t low, size_t high) { return high * (high + 1) / 2 + low; } // Channels low <= high
+
+    // Methods
+    inline void Fill(double x, double y)
+    {
+        const int channelX = FindChannel(x), channelY = FindChannel(y);
+        if (channelX >= 0 && channelY >= 0)
+            FillChannels(std::min(channelX, channelY), std::max(channelX, channelY));
+    }
+    inline void Fill(double x, double y, double weight) // Integer storage truncates the weight
+    {
+        const int channelX = FindChannel(x), channelY = FindChannel(y);
+        if (channelX < 0 || channelY < 0)
+            return;
+        Allocate();
+        fBins[Index(std::min(channelX, channelY), std::max(channelX, channelY))] += static_cast<S>(weight);
+        fEntries++;
+    }
+    // Every unordered pair of the gammas of one event, e.g. the add-back energies of the clovers that fired
+    void FillCoincidences(const double* energies, size_t nGammas)
+    {
+        fChannels.clear();
+        for (size_t i = 0; i < nGammas; i++)
+        {
+            const int channel = FindChannel(energies[i]);
+            if (channel >= 0)
+                fChannels.push_back(channel);
+        }
+        std::sort(fChannels.begin(), fChannels.end());
+        for (size_t j = 1; j < fChannels.size(); j++)
+        {
+            for (size_t i = 0; i < j; i++)
+                FillChannels(fChannels[i], fChannels[j]);
+        }
+    }
+    void ApplyFills(const uint32_t* bins, size_t nFills) override
+    {
+        Allocate();
+        for (size_t i = 0; i < nFills; i++)
+            fBins[bins[i]] += 1;
+        fEntries += nFills;
+    }
+    void Add(const TCASymmetricH2* other)
+    {
+        if (other->fNBins != fNBins || other->fMin != fMin || other->fMax != fMax)
+        {
+            throw std::runtime_error(Form("[ERROR] Cannot add histogram %s to %s, their binning differs", other->GetName(), GetName()));
+        }
+        fEntries += other->fEntries;
+        if (!other->IsAllocated())
+            return;
+        Allocate();
+        for (size_t bin = 0; bin < fBins.size(); bin++)
+            fBins[bin] += other->fBins[bin];
+    }
+    void AddChannels(size_t low, size_t high, S content) // For projections, entries are left alone
+    {
+        Allocate();
+        fBins[Index(low, high)] += content;
+    }
+    inline void SetEntries(uint64_t entries) { fEntries = entries; }
+    void Reset() // Also releases the bins
+    {
+        std::vector<S>().swap(fBins);
+        fEntries = 0;
+    }
+    std::unique_ptr<TH2D> ToROOT() const
+    {
+        auto hist = std::make_unique<TH2D>(fName.c_str(), fTitle.c_str(), fNBins, fMin, fMax, fNBins, fMin, fMax);
+        hist->SetDirectory(nullptr);
+        for (size_t high = 0; IsAllocated() && high < static_cast<size_t>(fNBins); high++)
+        {
+            for (size_t low = 0; low <= high; low++)
+            {
+                const S content = fBins[Index(low, high)];
+                if (content == S())
+                    continue;
+                hist->SetBinContent(static_cast<Int_t>(low + 1), static_cast<Int_t>(high + 1), static_cast<Double_t>(low == high ? content + content : content));
+                hist->SetBinContent(static_cast<Int_t>(high + 1), static_cast<Int_t>(low + 1), static_cast<Double_t>(low == high ? content + content : content));
+            }
+        }
+        hist->ResetStats();
+        hist->SetEntries(static_cast<Double_t>(2 * fEntries));
+        return hist;
+    }
+    Int_t Write(const char* name = nullptr, Int_t option = 0, Int_t bufsize = 0) const { return ToROOT()->Write(name, option, bufsize); }
+    // Radware .m4b for escl8r, channel i is bin i + 1. Gate on energies through the calibration min + (i + 0.5) * (max - min) / nBins
+    void WriteM4b(const std::string& fileName) const
+    {
+        if (static_cast<size_t>(fNBins) > CASymmetricHistogram::kM4bChannels)
+        {
+            throw std::runtime_error(Form("[ERROR] Histogram %s has %d bins, .m4b matrices hold %zu channels", GetName(), fNBins, CASymmetricHistogram::kM4bChannels));
+        }
+        CASymmetricHistogram::WriteM4b(fileName, [this](size_t row, std::vector<uint32_t>& counts)
+                                       {
+            std::fill(counts.begin(), counts.end(), 0);
+            if (row >= static_cast<size_t>(fNBins))
+                return;
+            for (size_t column = 0; column < static_cast<size_t>(fNBins); column++)
+            {
+                const double content = static_cast<double>(GetContent(Index(std::min(row, column), std::max(row, column))));
+                counts[column] = CASymmetricHistogram::ToCount(row == column ? 2 * content : content);
+            } });
+    }
+
+private:
+    inline S GetContent(size_t index) const { return IsAllocated() ? fBins[index] : S(); }
+    inline void Allocate()
+    {
+        if (fBins.empty())
+            fBins.assign(GetNcells(), S());
+    }
+    inline void FillChannels(size_t low, size_t high)
+    {
+        if (fFillBuffer != nullptr)
+        {
+            fFillBuffer->Push(fFillBufferID, static_cast<uint32_t>(Index(low, high)));
+            return;
+        }
+        Allocate();
+        fBins[Index(low, high)] += 1;
+        fEntries++;
+    }
+
+    std::string fName;
+    std::string fTitle;
+    int fNBins;
+    double fMin;
+    double fMax;
+    double fScale;
+    double fOverflow;
+    uint64_t fEntries = 0;
+    std::vector<S> fBins;       // Packed triangle, row high holds channels 0 to high, empty until the first fill
+    std::vector<int> fChannels; // Scratch of FillCoincidences(), each replica has its own
+};
+
+// Gamma-gamma-gamma cube as the tetrahedron x <= y <= z, cut into bricks that are only allocated once filled. Replicas
+// of a cube too large for memory as a whole cost the bricks their thread touched. Written as the symmetrised gamma-gamma
+// projection (ROOT, .m4b) and as a compressed cube file, brick by brick, see WriteCube()
+template <typename S>
+class TCASymmetricH3 : public TCAFillTarget
+{
+public:
+    typedef S StorageType;
+
+    static inline constexpr size_t kBrickBits = 4;
+    static inline constexpr size_t kBrickSide = size_t(1) << kBrickBits; // Bins per brick side
+    static inline constexpr size_t kBrickMask = kBrickSide - 1;
+    static inline constexpr size_t kBrickCells = kBrickSide * kBrickSide * kBrickSide;
+
+    // Constructors
+    TCASymmetricH3(const char* name, const char* title, int nBins, double min, double max)
+        : fName(name), fTitle(title), fNBins(nBins), fMin(min), fMax(max), fScale(nBins / (max - min)), fOverflow(nBins + 1.0),
+          fNBricks((nBins + kBrickMask) >> kBrickBits), fBrickIndex(BrickIndex(fNBricks - 1, fNBricks - 1, fNBricks - 1) + 1, 0)
+    {
+        if (nBins <= 0 || !(max > min))
+        {
+            throw std::runtime_error(Form("[ERROR] Histogram %s needs at least one bin and max > min", name));
+        }
+    }
+
+    // Getters
+    inline const char* GetName() const { return fName.c_str(); }
+    inline const char* GetTitle() const { return fTitle.c_str(); }
+    inline int GetNbinsX() const { return fNBins; }
+    inline double GetXmin() const { return fMin; }
+    inline double GetXmax() const { return fMax; }
+    inline uint64_t GetEntries() const { return fEntries; }
+    inline size_t GetBrickCount() const { return fBricks.size(); } // Allocated bricks
+    inline size_t GetNcells() const { return fBrickIndex.size() * kBrickCells; } // Cells of all bricks, allocated or not
+    inline size_t GetAllocatedBytes() const { return fBricks.size() * kBrickCells * sizeof(S) + fBrickIndex.size() * sizeof(uint32_t); }
+    S GetBinContent(size_t binX, size_t binY, size_t binZ) const // ROOT bin numbers 1 to nBins in any order, packed count
+    {
+        if (std::min({binX, binY, binZ}) < 1 || std::max({binX, binY, binZ}) > static_cast<size_t>(fNBins))
+            return S();
+        size_t channels[3] = {binX - 1, binY - 1, binZ - 1};
+        std::sort(channels, channels + 3);
+        const uint32_t brick = fBrickIndex[BrickIndex(channels[0] >> kBrickBits, channels[1] >> kBrickBits, channels[2] >> kBrickBits)];
+        return brick == 0 ? S() : fBricks[brick - 1][CellIndex(channels[0], channels[1], channels[2])];
+    }
+    inline int FindChannel(double x) const // 0 to nBins - 1, -1 outside the axis
+    {
+        const size_t bin = CAFlatBin(x, fMin, fScale, fOverflow);
+        return bin >= 1 && bin <= static_cast<size_t>(fNBins) ? static_cast<int>(bin - 1) : -1;
+    }
+
+    // Methods
+    inline void Fill(double x, double y, double z)
+    {
+        int channels[3] = {FindChannel(x), FindChannel(y), FindChannel(z)};
+        std::sort(channels, channels + 3);
+        if (channels[0] >= 0)
+        {
+            Cell(channels[0], channels[1], channels[2]) += 1;
+            fEntries++;
+        }
+    }
+    // Every unordered triple of the gammas of one event, e.g. the add-back energies of the clovers that fired
+    void FillCoincidences(const double* energies, size_t nGammas)
+    {
+        fChannels.clear();
+        for (size_t i = 0; i < nGammas; i++)
+        {
+            const int channel = FindChannel(energies[i]);
+            if (channel >= 0)
+                fChannels.push_back(channel);
+        }
+        std::sort(fChannels.begin(), fChannels.end());
+        for (size_t k = 2; k < fChannels.size(); k++)
+        {
+            for (size_t j = 1; j < k; j++)
+            {
+                for (size_t i = 0; i < j; i++)
+                    Cell(fChannels[i], fChannels[j], fChannels[k]) += 1;
+            }
+        }
+        const size_t n = fChannels.size();
+        fEntries += n < 3 ? 0 : n * (n - 1) * (n - 2) / 6;
+    }
+    // Fills land anywhere in a huge array, bucketing them by histogram gains nothing, so cubes always fill directly and
+    // never register with a buffer
+    inline void SetFillBuffer(TCAFillBuffer*) {}
+    void ApplyFills(const uint32_t*, size_t) override
+    {
+        throw std::runtime_error(Form("[ERROR] Cube %s fills directly, it cannot take buffered fills", GetName()));
+    }
+    void Add(const TCASymmetricH3* other)
+    {
+        if (other->fNBins != fNBins || other->fMin != fMin || other->fMax != fMax)
+        {
+            throw std::runtime_error(Form("[ERROR] Cannot add histogram %s to %s, their binning differs", other->GetName(), GetName()));
+        }
+        for (size_t brick = 0; brick < fBrickIndex.size(); brick++)
+        {
+            if (other->fBrickIndex[brick] == 0)
+                continue;
+            if (fBrickIndex[brick] == 0)
+                fBrickIndex[brick] = AllocateBrick();
+            auto& cells = fBricks[fBrickIndex[brick] - 1];
+            const auto& otherCells = other->fBricks[other->fBrickIndex[brick] - 1];
+            for (size_t cell = 0; cell < kBrickCells; cell++)
+                cells[cell] += otherCells[cell];
+        }
+        fEntries += other->fEntries;
+    }
+    void Reset()
+    {
+        fBricks.clear();
+        std::fill(fBrickIndex.begin(), fBrickIndex.end(), 0);
+        fEntries = 0;
+    }
+    // Gamma-gamma matrix of the cube, each triple adds its three pairs
+    std::unique_ptr<TCASymmetricH2<double>> Project() const
+    {
+        auto projection = std::make_unique<TCASymmetricH2<double>>(fName.c_str(), fTitle.c_str(), fNBins, fMin, fMax);
+        ForEachCell([&projection](size_t x, size_t y, size_t z, S content)
+                    {
+            projection->AddChannels(x, y, content);
+            projection->AddChannels(x, z, content);
+            projection->AddChannels(y, z, content); });
+        projection->SetEntries(3 * fEntries);
+        return projection;
+    }
+    std::unique_ptr<TH2D> ToROOT() const { return Project()->ToROOT(); }
+    Int_t Write(const char* name = nullptr, Int_t option = 0, Int_t bufsize = 0) const { return ToROOT()->Write(name, option, bufsize); }
+    void WriteM4b(const std::string& fileName) const { Project()->WriteM4b(fileName); }
+    // Allocated bricks as 32-bit counts, each compressed on its own and written as it is packed
+    void WriteCube(const std::string& fileName, ROOT::RCompressionSetting::EAlgorithm::EValues algorithm = ROOT::RCompressionSetting::EAlgorithm::kZSTD) const
+    {
+        CASymmetricHistogram::CubeHeader header = {};
+        std::copy(std::begin(CASymmetricHistogram::kCubeMagic), std::end(CASymmetricHistogram::kCubeMagic), header.fMagic);
+        header.fVersion = CASymmetricHistogram::kCubeVersion;
+        header.fAlgorithm = algorithm;
+        header.fNBins = fNBins;
+        header.fBrickSide = kBrickSide;
+        header.fMin = fMin;
+        header.fMax = fMax;
+        header.fNBricks = fBricks.size();
+        header.fEntries = fEntries;
+        FILE* file = CASymmetricHistogram::CreateCube(fileName, header);
+        std::vector<uint32_t> cells(kBrickCells);
+        for (size_t brick = 0; brick < fBrickIndex.size(); brick++)
+        {
+            if (fBrickIndex[brick] == 0)
+                continue;
+            const auto& brickCells = fBricks[fBrickIndex[brick] - 1];
+            for (size_t cell = 0; cell < kBrickCells; cell++)
+                cells[cell] = CASymmetricHistogram::ToCount(static_cast<double>(brickCells[cell]));
+            CASymmetricHistogram::WriteBrick(file, brick, cells, header.fAlgorithm);
+        }
+        CASymmetricHistogram::CloseCube(file, fileName);
+    }
+    static std::unique_ptr<TCASymmetricH3> ReadCube(const std::string& fileName, const char* name, const char* title)
+    {
+        CASymmetricHistogram::CubeHeader header;
+        FILE* file = CASymmetricHistogram::OpenCube(fileName, header);
+        if (header.fBrickSide != kBrickSide)
+        {
+            fclose(file);
+            throw std::runtime_error(Form("[ERROR] Cube %s has bricks of %u bins, expected %zu", fileName.c_str(), header.fBrickSide, kBrickSide));
+        }
+        auto cube = std::make_unique<TCASymmetricH3>(name, title, header.fNBins, header.fMin, header.fMax);
+        std::vector<uint32_t> cells(kBrickCells);
+        try
+        {
+            for (uint64_t i = 0; i < header.fNBricks; i++)
+            {
+                uint64_t brick = 0;
+                CASymmetricHistogram::ReadBrick(file, brick, cells);
+                if (brick >= cube->fBrickIndex.size())
+                {
+                    throw std::runtime_error("[ERROR] Cube " + fileName + " has a brick outside the cube");
+                }
+                if (cube->fBrickIndex[brick] == 0)
+                    cube->fBrickIndex[brick] = cube->AllocateBrick();
+                std::copy(cells.begin(), cells.end(), cube->fBricks[cube->fBrickIndex[brick] - 1].begin());
+            }
+        }
+        catch (...)
+        {
+            fclose(file);
+            throw;
+        }
+        fclose(file);
+        cube->fEntries = header.fEntries;
+        return cube;
+    }
+
+private:
+    static inline size_t BrickIndex(size_t low, size_t mid, size_t high) { return high * (high + 1) * (high + 2) / 6 + mid * (mid + 1) / 2 + low; }
+    static inline size_t CellIndex(size_t low, size_t mid, size_t high) { return ((high & kBrickMask) << kBrickBits | (mid & kBrickMask)) << kBrickBits | (low & kBrickMask); }
+    inline S& Cell(size_t low, size_t mid, size_t high) // Channels low <= mid <= high
+    {
+        uint32_t& brick = fBrickIndex[BrickIndex(low >> kBrickBits, mid >> kBrickBits, high >> kBrickBits)];
+        if (brick == 0)
+            brick = AllocateBrick();
+        return fBricks[brick - 1][CellIndex(low, mid, high)];
+    }
+    uint32_t AllocateBrick()
+    {
+        fBricks.emplace_back(kBrickCells, S());
+        return static_cast<uint32_t>(fBricks.size());
+    }
+    // Calls func(x, y, z, content) for the filled cells, x <= y <= z
+    template <typename Func>
+    void ForEachCell(Func&& func) const
+    {
+        for (size_t brickZ = 0; brickZ < fNBricks; brickZ++)
+        {
+            for (size_t brickY = 0; brickY <= brickZ; brickY++)
+            {
+                for (size_t brickX = 0; brickX <= brickY; brickX++)
+                {
+                    const uint32_t brick = fBrickIndex[BrickIndex(brickX, brickY, brickZ)];
+                    if (brick == 0)
+                        continue;
+                    const auto& cells = fBricks[brick - 1];
+                    for (size_t cell = 0; cell < kBrickCells; cell++)
+                    {
+                        if (cells[cell] == S())
+                            continue;
+                        const size_t x = brickX << kBrickBits | (cell & kBrickMask);
+                        const size_t y = brickY << kBrickBits | (cell >> kBrickBits & kBrickMask);
+                        const size_t z = brickZ << kBrickBits | cell >> 2 * kBrickBits;
+                        func(x, y, z, cells[cell]);
+                    }
+                }
+            }
+        }
+    }
+
+    std::string fName;
+    std::string fTitle;
+    int fNBins;
+    double fMin;
+    double fMax;
+    double fScale;
+    double fOverflow;
+    size_t fNBricks; // Bricks per axis
+    uint64_t fEntries = 0;
+    std::vector<uint32_t> fBrickIndex;   // Per brick x <= y <= z of the tetrahedron, 1 + its index in fBricks or 0 while unallocated
+    std::vector<std::vector<S>> fBricks; // Allocated bricks, z-major
+    std::vector<int> fChannels;          // Scratch of FillCoincidences(), each replica has its own
+};
+
+typedef TCASymmetricH2<uint32_t> TCASymmetricH2I;
+typedef TCASymmetricH2<float> TCASymmetricH2F;
+typedef TCASymmetricH3<uint32_t> TCASymmetricH3I;
+typedef TCASymmetricH3<float> TCASymmetricH3F;
+
+#endif // TCASYMMETRICHISTOGRAM_HPP
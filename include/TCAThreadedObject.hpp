@@ -0,0 +1,89 @@
+#ifndef TCATHREADEDOBJECT_HPP
+#define TCATHREADEDOBJECT_HPP
+
+// Standard C++ includes
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "CAUtilities.hpp"
+
+// Per-thread replicas of an object that is not a TObject, the counterpart of ROOT::TThreadedObject for the CASort-native
+// histograms. T needs a copy constructor that yields an empty replica of an unfilled model, Add(const T*), Reset() and
+// GetEntries(). The native histograms allocate their bins on the first fill, so a replica handed out to a thread that
+// never fills it stays a shell without bins, and the merge passes over it.
+template <typename T>
+class TCAThreadedObject
+{
+public:
+    // Constructors
+    template <typename... Args>
+    explicit TCAThreadedObject(Args&&... args) : fModel(std::forward<Args>(args)...) {}
+    TCAThreadedObject(const TCAThreadedObject&) = delete;
+
+    // Getters
+    inline const T& GetModel() const { return fModel; }
+    inline size_t GetReplicaCount() const
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        return fReplicas.size();
+    }
+
+    // Replica of the calling thread, copied from the unfilled model on first use. Look it up once per thread and keep it
+    std::shared_ptr<T> Get()
+    {
+        const auto threadID = std::this_thread::get_id();
+        std::lock_guard<std::mutex> lock(fMutex);
+        fFolded = false; // The replica handed out may be filled
+        for (const auto& [id, replica] : fReplicas)
+        {
+            if (id == threadID)
+                return replica;
+        }
+        fReplicas.emplace_back(threadID, std::make_shared<T>(fModel));
+        return fReplicas.back().second;
+    }
+
+    // Sum of all replicas. The filled replicas are folded into the first of them by a pairwise tree reduction on up to
+    // nThreads threads and the others are reset, so the sum over the replicas never changes: merging again gives the same
+    // result and costs nothing until some thread fetches its replica again. Replicas that were never filled are skipped.
+    // No thread may fill while merging.
+    std::shared_ptr<T> Merge(unsigned int nThreads = 1)
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        if (fReplicas.empty())
+            return std::make_shared<T>(fModel);
+        if (fFolded)
+            return fSum;
+
+        std::vector<T*> replicas;
+        fSum = fReplicas.front().second; // Stays the empty first replica if none was filled
+        for (const auto& [id, replica] : fReplicas)
+        {
+            if (replica->GetEntries() == 0)
+                continue;
+            if (replicas.empty())
+                fSum = replica;
+            replicas.push_back(replica.get());
+        }
+        CAUtilities::TreeReduce(replicas, nThreads);
+        if (replicas.size() > 1)
+            CAUtilities::ParallelFor(replicas.size() - 1, nThreads, [&replicas](size_t i) { replicas[i + 1]->Reset(); });
+        fFolded = true;
+        return fSum;
+    }
+
+private:
+    T fModel; // Never filled, holds the binning replicas are made from
+    mutable std::mutex fMutex;
+    std::vector<std::pair<std::thread::id, std::shared_ptr<T>>> fReplicas;
+    std::shared_ptr<T> fSum; // Replica Merge() folded the others into
+    bool fFolded = false;    // Merge() left everything in fSum and no replica was handed out since
+};
+
+#endif // TCATHREADEDOBJECT_HPP
@@ -0,0 +1,347 @@
+#ifndef TCATILEDHISTOGRAM_HPP
+#define TCATILEDHISTOGRAM_HPP
+
+// Standard C++ includes
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// ROOT includes
+#include <TH2D.h>
+#include <TString.h>
+
+// Project includes
+#include "TCAFillBuffer.hpp"
+#include "TCAFlatHistogram.hpp"
+
+// Storage tag for unweighted counts, e.g. TCATiledH2<TCACounter>: counters start at 16 bits and widen per tile
+struct TCACounter
+{
+};
+
+// Cells of one tile of S
+template <typename S, size_t N>
+class TCATileCells
+{
+public:
+    typedef S ValueType;
+
+    TCATileCells() : fCells(N, S()) {}
+
+    inline S Get(size_t cell) const { return fCells[cell]; }
+    inline void Increment(size_t cell) { fCells[cell] += 1; }
+    inline void Add(size_t cell, double weight) { fCells[cell] += static_cast<S>(weight); } // Integer storage truncates the weight
+    void Add(const TCATileCells& other)
+    {
+        for (size_t cell = 0; cell < N; cell++)
+            fCells[cell] += other.fCells[cell];
+    }
+    inline size_t GetBytes() const { return N * sizeof(S); }
+
+private:
+    std::vector<S> fCells;
+};
+
+// Counters of one tile, 16 bits wide until a cell would overflow, then widened together to 32 and later 64 bits. Most
+// tiles of a per-thread replica never see 65535 counts in a bin, so they cost a quarter of double storage. Only one of
+// the three arrays is allocated at a time.
+template <size_t N>
+class TCATileCells<TCACounter, N>
+{
+public:
+    typedef uint64_t ValueType;
+
+    TCATileCells() : fCells16(N, 0) {}
+
+    inline unsigned int GetWidth() const { return fWidth; } // Bytes per counter
+    inline uint64_t Get(size_t cell) const
+    {
+        switch (fWidth)
+        {
+        case 2:
+            return fCells16[cell];
+        case 4:
+            return fCells32[cell];
+        default:
+            return fCells64[cell];
+        }
+    }
+    inline void Increment(size_t cell) // Only a full counter takes the slow path, which widens the tile
+    {
+        switch (fWidth)
+        {
+        case 2:
+            if (fCells16[cell] != UINT16_MAX)
+            {
+                fCells16[cell]++;
+                return;
+            }
+            break;
+        case 4:
+            if (fCells32[cell] != UINT32_MAX)
+            {
+                fCells32[cell]++;
+                return;
+            }
+            break;
+        default:
+            fCells64[cell]++;
+            return;
+        }
+        Add(cell, uint64_t(1));
+    }
+    void Add(size_t cell, double weight) = delete; // Counters only count, a negative or fractional weight has no count
+    void Add(size_t cell, uint64_t count)
+    {
+        const uint64_t sum = Get(cell) + count;
+        Widen(GetRequiredWidth(sum));
+        Set(cell, sum);
+    }
+    void Add(const TCATileCells& other) // Widens to the wider of the two tiles first, and further where sums need it
+    {
+        Widen(other.fWidth);
+        if (fWidth == 2)
+        {
+            for (size_t cell = 0; cell < N; cell++)
+            {
+                const uint32_t sum = uint32_t(fCells16[cell]) + other.fCells16[cell];
+                if (sum > UINT16_MAX)
+                {
+                    Add(cell, uint64_t(other.fCells16[cell])); // Widens the tile, the rest continues at the new width
+                    for (cell++; cell < N; cell++)
+                        Add(cell, other.Get(cell));
+                    return;
+                }
+                fCells16[cell] = static_cast<uint16_t>(sum);
+            }
+            return;
+        }
+        for (size_t cell = 0; cell < N; cell++)
+            Add(cell, other.Get(cell));
+    }
+    inline size_t GetBytes() const { return N * fWidth; }
+
+private:
+    static inline unsigned int GetRequiredWidth(uint64_t count) { return count <= UINT16_MAX ? 2 : count <= UINT32_MAX ? 4 : 8; }
+    inline void Set(size_t cell, uint64_t count)
+    {
+        switch (fWidth)
+        {
+        case 2:
+            fCells16[cell] = static_cast<uint16_t>(count);
+            break;
+        case 4:
+            fCells32[cell] = static_cast<uint32_t>(count);
+            break;
+        default:
+            fCells64[cell] = count;
+        }
+    }
+    void Widen(unsigned int width)
+    {
+        if (width <= fWidth)
+            return;
+        if (width == 4)
+        {
+            fCells32.assign(fCells16.begin(), fCells16.end());
+        }
+        else if (fWidth == 2)
+        {
+            fCells64.assign(fCells16.begin(), fCells16.end());
+        }
+        else
+        {
+            fCells64.assign(fCells32.begin(), fCells32.end());
+        }
+        std::vector<uint16_t>().swap(fCells16);
+        if (width == 8)
+            std::vector<uint32_t>().swap(fCells32);
+        fWidth = width;
+    }
+
+    unsigned int fWidth = 2;
+    std::vector<uint16_t> fCells16;
+    std::vector<uint32_t> fCells32;
+    std::vector<uint64_t> fCells64;
+};
+
+// Sparse 2D histogram for large, mostly empty matrices (crosstalk, gamma-gamma). The bins, under- and overflow
+// included, are cut into fixed square tiles that are only allocated once a fill lands in them, so a per-thread replica
+// of a 4k x 4k matrix costs its tile directory plus the tiles that thread touched. Replicas merge tile by tile and the
+// matrix only becomes a dense TH2D when it is written. Fills and bin layout are those of TCAFlatH2. With S =
+// TCACounter each tile holds adaptive-width counters (see TCATileCells), widened when a bin or a merge needs it.
+template <typename S>
+class TCATiledH2 : public TCAFillTarget
+{
+public:
+    typedef S StorageType;
+
+    static inline constexpr size_t kTileBits = 6;
+    static inline constexpr size_t kTileSide = size_t(1) << kTileBits; // Bins per tile side
+    static inline constexpr size_t kTileMask = kTileSide - 1;
+    static inline constexpr size_t kTileCells = kTileSide * kTileSide;
+
+    typedef TCATileCells<S, kTileCells> Tile;
+    typedef typename Tile::ValueType ValueType; // Bin contents, uint64_t for TCACounter
+
+    // Constructors
+    TCATiledH2(const char* name, const char* title, int nBinsX, double xMin, double xMax, int nBinsY, double yMin, double yMax)
+        : fName(name), fTitle(title), fNBinsX(nBinsX), fNBinsY(nBinsY), fXMin(xMin), fXMax(xMax), fYMin(yMin), fYMax(yMax),
+          fXScale(nBinsX / (xMax - xMin)), fYScale(nBinsY / (yMax - yMin)), fXOverflow(nBinsX + 1.0), fYOverflow(nBinsY + 1.0),
+          fNTilesX((nBinsX + 2 + kTileMask) >> kTileBits), fNTilesY((nBinsY + 2 + kTileMask) >> kTileBits), fTileIndex(fNTilesX * fNTilesY, 0)
+    {
+        if (nBinsX <= 0 || nBinsY <= 0 || !(xMax > xMin) || !(yMax > yMin))
+        {
+            throw std::runtime_error(Form("[ERROR] Histogram %s needs at least one bin and max > min on both axes", name));
+        }
+    }
+
+    // Getters
+    inline const char* GetName() const { return fName.c_str(); }
+    inline const char* GetTitle() const { return fTitle.c_str(); }
+    inline int GetNbinsX() const { return fNBinsX; }
+    inline int GetNbinsY() const { return fNBinsY; }
+    inline size_t GetNcells() const { return static_cast<size_t>(fNBinsX + 2) * (fNBinsY + 2); }
+    inline uint64_t GetEntries() const { return fEntries; }
+    inline size_t GetTileCount() const { return fTiles.size(); } // Allocated tiles
+    size_t GetAllocatedBytes() const
+    {
+        size_t bytes = fTileIndex.size() * sizeof(uint32_t);
+        for (const auto& tile : fTiles)
+            bytes += tile.GetBytes();
+        return bytes;
+    }
+    inline size_t GetBin(size_t binX, size_t binY) const { return binY * (fNBinsX + 2) + binX; } // As TH2::GetBin()
+    ValueType GetBinContent(size_t binX, size_t binY) const
+    {
+        const uint32_t tile = fTileIndex[(binY >> kTileBits) * fNTilesX + (binX >> kTileBits)];
+        return tile == 0 ? ValueType() : fTiles[tile - 1].Get(GetCell(binX, binY));
+    }
+    inline size_t FindBin(double x, double y) const { return GetBin(CAFlatBin(x, fXMin, fXScale, fXOverflow), CAFlatBin(y, fYMin, fYScale, fYOverflow)); }
+
+    // Methods
+    inline void Fill(double x, double y)
+    {
+        const size_t binX = CAFlatBin(x, fXMin, fXScale, fXOverflow);
+        const size_t binY = CAFlatBin(y, fYMin, fYScale, fYOverflow);
+        if (fFillBuffer != nullptr)
+        {
+            fFillBuffer->Push(fFillBufferID, static_cast<uint32_t>(GetBin(binX, binY)));
+            return;
+        }
+        GetTile(binX, binY).Increment(GetCell(binX, binY));
+        fEntries++;
+    }
+    inline void Fill(double x, double y, double weight) // Integer storage truncates the weight
+    {
+        static_assert(!std::is_same_v<S, TCACounter>, "Counter storage only takes unweighted fills, use a TCATiledH2F for weights");
+        const size_t binX = CAFlatBin(x, fXMin, fXScale, fXOverflow);
+        const size_t binY = CAFlatBin(y, fYMin, fYScale, fYOverflow);
+        GetTile(binX, binY).Add(GetCell(binX, binY), weight);
+        fEntries++;
+    }
+    void ApplyFills(const uint32_t* bins, size_t nFills) override
+    {
+        const size_t nCellsX = fNBinsX + 2;
+        for (size_t i = 0; i < nFills; i++)
+        {
+            const size_t binX = bins[i] % nCellsX;
+            const size_t binY = bins[i] / nCellsX;
+            GetTile(binX, binY).Increment(GetCell(binX, binY));
+        }
+        fEntries += nFills;
+    }
+    void Add(const TCATiledH2* other)
+    {
+        if (other->fNBinsX != fNBinsX || other->fNBinsY != fNBinsY || other->fXMin != fXMin || other->fXMax != fXMax || other->fYMin != fYMin || other->fYMax != fYMax)
+        {
+            throw std::runtime_error(Form("[ERROR] Cannot add histogram %s to %s, their binning differs", other->GetName(), GetName()));
+        }
+        // Tile by tile, tiles other never touched cost nothing
+        for (size_t tile = 0; tile < fTileIndex.size(); tile++)
+        {
+            if (other->fTileIndex[tile] == 0)
+                continue;
+            if (fTileIndex[tile] == 0)
+                fTileIndex[tile] = AllocateTile();
+            fTiles[fTileIndex[tile] - 1].Add(other->fTiles[other->fTileIndex[tile] - 1]);
+        }
+        fEntries += other->fEntries;
+    }
+    void Reset()
+    {
+        fTiles.clear();
+        std::fill(fTileIndex.begin(), fTileIndex.end(), 0);
+        fEntries = 0;
+    }
+    std::unique_ptr<TH2D> ToROOT() const
+    {
+        auto hist = std::make_unique<TH2D>(fName.c_str(), fTitle.c_str(), fNBinsX, fXMin, fXMax, fNBinsY, fYMin, fYMax);
+        hist->SetDirectory(nullptr);
+        for (size_t tileY = 0; tileY < fNTilesY; tileY++)
+        {
+            for (size_t tileX = 0; tileX < fNTilesX; tileX++)
+            {
+                const uint32_t tile = fTileIndex[tileY * fNTilesX + tileX];
+                if (tile == 0)
+                    continue;
+                const auto& cells = fTiles[tile - 1];
+                for (size_t cell = 0; cell < kTileCells; cell++)
+                {
+                    const size_t binX = tileX << kTileBits | (cell & kTileMask);
+                    const size_t binY = tileY << kTileBits | cell >> kTileBits;
+                    const ValueType content = cells.Get(cell);
+                    if (content != ValueType() && binX < static_cast<size_t>(fNBinsX + 2) && binY < static_cast<size_t>(fNBinsY + 2))
+                        hist->SetBinContent(static_cast<Int_t>(GetBin(binX, binY)), static_cast<Double_t>(content));
+                }
+            }
+        }
+        hist->ResetStats();
+        hist->SetEntries(static_cast<Double_t>(fEntries));
+        return hist;
+    }
+    Int_t Write(const char* name = nullptr, Int_t option = 0, Int_t bufsize = 0) const { return ToROOT()->Write(name, option, bufsize); }
+
+private:
+    static inline size_t GetCell(size_t binX, size_t binY) { return (binY & kTileMask) << kTileBits | (binX & kTileMask); } // Within its tile
+    inline Tile& GetTile(size_t binX, size_t binY)
+    {
+        uint32_t& tile = fTileIndex[(binY >> kTileBits) * fNTilesX + (binX >> kTileBits)];
+        if (tile == 0)
+            tile = AllocateTile();
+        return fTiles[tile - 1];
+    }
+    uint32_t AllocateTile()
+    {
+        fTiles.emplace_back();
+        return static_cast<uint32_t>(fTiles.size());
+    }
+
+    std::string fName;
+    std::string fTitle;
+    int fNBinsX;
+    int fNBinsY;
+    double fXMin;
+    double fXMax;
+    double fYMin;
+    double fYMax;
+    double fXScale;
+    double fYScale;
+    double fXOverflow;
+    double fYOverflow;
+    size_t fNTilesX;
+    size_t fNTilesY;
+    uint64_t fEntries = 0;
+    std::vector<uint32_t> fTileIndex; // Per tile, 1 + its index in fTiles or 0 while unallocated
+    std::vector<Tile> fTiles;         // Allocated tiles, rows of kTileSide bins
+};
+
+typedef TCATiledH2<uint32_t> TCATiledH2I;
+typedef TCATiledH2<float> TCATiledH2F;
+typedef TCATiledH2<TCACounter> TCATiledH2C; // Counts, 16 to 64 bits per tile as needed
+
+#endif // TCATILEDHISTOGRAM_HPP
@@ -0,0 +1,51 @@
+#ifndef TCAWORKQUEUE_HPP
+#define TCAWORKQUEUE_HPP
+
+// Standard C++ includes
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// ROOT includes
+#include <RtypesCore.h>
+
+// Project includes
+
+// Work-stealing queue of entry ranges. Each worker slot starts with a contiguous share of the ranges and takes them from the
+// front of its own deque, so it walks the run in file order. A slot that runs dry steals from the back of another slot's
+// deque, taking the work furthest from where the owner is reading.
+class TCAWorkQueue
+{
+public:
+    typedef std::pair<Long64_t, Long64_t> WorkUnit; // Entries [first, second)
+
+    // Constructors
+    TCAWorkQueue() = delete;
+    TCAWorkQueue(const TCAWorkQueue&) = delete;
+    TCAWorkQueue(const std::vector<WorkUnit>& units, size_t nSlots);
+
+    // Getters
+    inline size_t GetSlotCount() const { return fDeques.size(); }
+    inline size_t GetStealCount() const { return fSteals; }
+
+    // Methods
+    bool Pop(size_t slot, WorkUnit& unit); // False once every deque is empty
+    void Stop();                           // Drops the units not yet taken, Pop() then fails everywhere
+
+private:
+    struct SlotDeque
+    {
+        std::mutex fMutex;
+        std::deque<WorkUnit> fUnits;
+    };
+
+    bool Steal(size_t slot, WorkUnit& unit);
+
+    std::vector<std::unique_ptr<SlotDeque>> fDeques;
+    std::atomic<size_t> fSteals = 0;
+};
+
+#endif // TCAWORKQUEUE_HPP
@@ -25,19 +25,6 @@ double CACrosstalkCorrection::CrosstalkFitFunction(double* x, double* par)
     return x[0] * slope + intercept;
 }
 
-void CACrosstalkCorrection::FillXTalkHistograms(const std::array<std::shared_ptr<TH2D>, 6>& xtalkPairHists, const std::array<double, 4>& xtalE, std::array<double, 4>& xtalT)
-{
-    static constexpr std::array<std::pair<short, short>, 6> xtalPairs = {{{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}}};
-    for (size_t i = 0; i < xtalPairs.size(); i++)
-    {
-        auto [xtalX, xtalY] = xtalPairs[i];
-        if ((xtalE[xtalX] > CAAddBack::kAddBackThreshold) && (xtalE[xtalY] > CAAddBack::kAddBackThreshold) && (fabs(xtalT[xtalX] - xtalT[xtalY]) < CAAddBack::kAddBackWindow))
-        {
-            xtalkPairHists[i]->Fill(xtalE[xtalX], xtalE[xtalY]);
-        }
-    }
-}
-
 std::shared_ptr<TGraphErrors> CACrosstalkCorrection::BuildCrosstalkGraph(const TH2D* hist)
 {
     // Get details from histogram
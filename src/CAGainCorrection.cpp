@@ -11,9 +11,9 @@
 #include "CAGainCorrection.hpp"
 #include "CAUtilities.hpp"
 
-std::vector<std::vector<std::function<double(double)>>> CAGainCorrection::MakeCorrections(const std::string& fileName)
+std::vector<std::vector<CAGainCorrection::Coefficients>> CAGainCorrection::ReadCoefficients(const std::string& fileName)
 {
-    std::vector<std::vector<std::function<double(double)>>> gainshiftFunctions;
+    std::vector<std::vector<Coefficients>> coefficients;
 
     std::string gsFileName = fileName;
 
@@ -26,7 +26,7 @@ std::vector<std::vector<std::function<double(double)>>> CAGainCorrection::MakeCo
     auto rawData = CAUtilities::ReadCAFile(gsFileName);
     for (const auto& module_Data : rawData)
     {
-        std::vector<std::function<double(double)>> channelFunctions;
+        std::vector<Coefficients> channelCoefficients;
         for (const auto& channelData : module_Data)
         {
 
@@ -38,14 +38,21 @@ std::vector<std::vector<std::function<double(double)>>> CAGainCorrection::MakeCo
             int channel = static_cast<int>(channelData[0]);
             double offset = channelData[1];
             double gain = channelData[2];
-            channelFunctions.push_back([offset, gain](double x)
-                                       { return gain * x + offset; });
+            channelCoefficients.push_back({offset, gain});
 #if DEBUG >= 2
             printf("[INFO] Channel %d: Offset = %.6f, Gain = %.6f\n", channel, offset, gain);
 #endif
         }
-        gainshiftFunctions.push_back(channelFunctions);
+        coefficients.push_back(channelCoefficients);
     }
 
+    return coefficients;
+}
+
+std::vector<std::vector<std::function<double(double)>>> CAGainCorrection::MakeCorrections(const std::string& fileName)
+{
+    std::vector<std::vector<std::function<double(double)>>> gainshiftFunctions;
+    for (const auto& moduleCoefficients : ReadCoefficients(fileName))
+        gainshiftFunctions.emplace_back(moduleCoefficients.begin(), moduleCoefficients.end());
     return gainshiftFunctions;
 }
\ No newline at end of file
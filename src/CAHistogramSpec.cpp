@@ -0,0 +1,182 @@
+// C++ Includes
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+// ROOT Includes
+#include <TString.h>
+
+// Project Includes
+#include "CAConfiguration.hpp"
+#include "CAHistogramSpec.hpp"
+#include "TCAChannel.hpp"
+#include "TCADAQModule.hpp"
+#include "TCADetector.hpp"
+#include "TCAExperiment.hpp"
+#include "TCAFlatHistogram.hpp"
+#include "TCAHistogramFamily.hpp"
+
+namespace
+{
+    TCAEvent::FilterID GetFilterID(const std::string& name)
+    {
+        for (size_t filterID = 0; filterID < TCAEvent::kFilterNames.size(); filterID++)
+        {
+            if (name == TCAEvent::kFilterNames[filterID])
+                return static_cast<TCAEvent::FilterID>(filterID);
+        }
+        throw std::runtime_error("[ERROR] Unknown source filter " + name);
+    }
+
+    bool CoversModule(const CAHistogramSpec::FamilySpec& spec, size_t moduleID)
+    {
+        return spec.classes == "all" || (moduleID < kModuleClasses.size() && spec.classes.find(kModuleClasses[moduleID]) != std::string::npos);
+    }
+
+    template <typename H>
+    size_t ExpandFamily(TCAExperiment& experiment, const CAHistogramSpec::FamilySpec& spec, const std::vector<std::vector<CAGainCorrection::Coefficients>>& gainShifts)
+    {
+        const char* source = TCAEvent::kFilterNames[spec.filterID];
+        const char* stage = spec.stage == CAHistogramSpec::kGain ? "Gain-Matched" : "Raw";
+        auto family = experiment.AddHistogram<TCAHistogramFamily<H>>(Form("%s_family", spec.name.c_str()), Form("%s %s spectra", stage, source), spec.filterID);
+
+        size_t nSkipped = 0;
+        for (size_t moduleIdx = 0; moduleIdx < experiment.GetModuleCount(); moduleIdx++)
+        {
+            auto module = experiment.GetModule(moduleIdx);
+            const size_t moduleID = module->GetModuleID();
+            if (!CoversModule(spec, moduleID))
+                continue;
+
+            // Channels without coefficients have no gain-matched spectrum, as in the built-in histograms
+            auto getCoefficients = [&](size_t ch, CAGainCorrection::Coefficients& coefficients)
+            {
+                if (spec.stage == CAHistogramSpec::kRaw)
+                    return true;
+                if (moduleID >= gainShifts.size() || ch >= gainShifts[moduleID].size())
+                {
+                    nSkipped++;
+                    return false;
+                }
+                coefficients = gainShifts[moduleID][ch];
+                return true;
+            };
+            auto addMember = [&](TCAHistogramOwner* owner)
+            {
+                auto member = owner->AddHistogram<TCAHistogram<H>>(Form("%s_%s", owner->GetName(), spec.name.c_str()), Form("%s %s %s;%s (a.u.);Counts", owner->GetTitle(), stage, source, source), spec.nBins, spec.min, spec.max);
+                member->SetFillFunction(nullptr); // Filled by the family
+                return family->AddMember(member);
+            };
+
+            if (spec.owner == CAHistogramSpec::kChannel)
+            {
+                for (size_t ch = 0; ch < module->GetChannelCount(); ch++)
+                {
+                    CAGainCorrection::Coefficients coefficients;
+                    if (getCoefficients(ch, coefficients))
+                        family->AddRow(moduleID, ch, addMember(module->GetChannel(ch)), coefficients.offset, coefficients.gain);
+                }
+                continue;
+            }
+
+            for (size_t detectorIdx = 0; detectorIdx < module->GetDetectorCount(); detectorIdx++)
+            {
+                auto detector = module->GetDetector(detectorIdx);
+                const auto& channels = detector->GetChannels();
+                std::vector<std::pair<size_t, CAGainCorrection::Coefficients>> rows;
+                for (size_t ch = 0; ch < module->GetChannelCount(); ch++)
+                {
+                    CAGainCorrection::Coefficients coefficients;
+                    if (std::find(channels.begin(), channels.end(), module->GetChannel(ch)) != channels.end() && getCoefficients(ch, coefficients))
+                        rows.emplace_back(ch, coefficients);
+                }
+                if (rows.empty())
+                    continue;
+                const size_t member = addMember(detector);
+                for (const auto& [ch, coefficients] : rows)
+                    family->AddRow(moduleID, ch, member, coefficients.offset, coefficients.gain);
+            }
+        }
+
+        if (nSkipped > 0)
+            printf("[WARN] %zu channels have no gain shift data and are left out of the %s spectra\n", nSkipped, spec.name.c_str());
+        return family->GetMemberCount();
+    }
+} // namespace
+
+std::vector<CAHistogramSpec::FamilySpec> CAHistogramSpec::ReadSpecFile(const std::string& fileName)
+{
+    std::ifstream inputFile(fileName);
+    if (!inputFile.is_open())
+    {
+        throw std::runtime_error("[ERROR] Could not open histogram specification file " + fileName);
+    }
+
+    std::vector<FamilySpec> specs;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(inputFile, line); lineNumber++)
+    {
+        // Skip empty and comment lines
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[line.find_first_not_of(" \t")] == '#')
+            continue;
+
+        const std::string where = fileName + ":" + std::to_string(lineNumber);
+        std::istringstream iss(line);
+        FamilySpec spec;
+        std::string owner, source, stage;
+        if (!(iss >> spec.name >> spec.type >> owner >> source >> stage >> spec.nBins >> spec.min >> spec.max >> spec.classes))
+        {
+            throw std::runtime_error("[ERROR] Expected name type owner source stage bins min max classes in " + where);
+        }
+
+        if (spec.type != "H1I" && spec.type != "H1F" && spec.type != "H1D")
+            throw std::runtime_error("[ERROR] Unknown histogram type " + spec.type + " in " + where + ", use H1I, H1F or H1D");
+        if (owner == "channel")
+            spec.owner = kChannel;
+        else if (owner == "detector")
+            spec.owner = kDetector;
+        else
+            throw std::runtime_error("[ERROR] Unknown owner " + owner + " in " + where + ", use channel or detector");
+        try
+        {
+            spec.filterID = GetFilterID(source);
+        }
+        catch (const std::exception& e)
+        {
+            throw std::runtime_error(std::string(e.what()) + " in " + where);
+        }
+        if (stage == "raw")
+            spec.stage = kRaw;
+        else if (stage == "gain")
+            spec.stage = kGain;
+        else
+            throw std::runtime_error("[ERROR] Unknown stage " + stage + " in " + where + ", use raw or gain");
+        if (spec.nBins <= 0 || !(spec.max > spec.min))
+            throw std::runtime_error("[ERROR] Family " + spec.name + " needs at least one bin and max > min in " + where);
+        for (const auto& other : specs)
+        {
+            if (other.name == spec.name)
+                throw std::runtime_error("[ERROR] Family " + spec.name + " is defined twice in " + fileName);
+        }
+        specs.push_back(spec);
+    }
+    printf("[INFO] Read %zu histogram families from %s\n", specs.size(), fileName.c_str());
+    return specs;
+}
+
+size_t CAHistogramSpec::Expand(TCAExperiment& experiment, const std::vector<FamilySpec>& specs, const std::vector<std::vector<CAGainCorrection::Coefficients>>& gainShifts)
+{
+    size_t nHistograms = 0;
+    for (const auto& spec : specs)
+    {
+        if (spec.type == "H1I")
+            nHistograms += ExpandFamily<TCAFlatH1I>(experiment, spec, gainShifts);
+        else if (spec.type == "H1F")
+            nHistograms += ExpandFamily<TCAFlatH1F>(experiment, spec, gainShifts);
+        else
+            nHistograms += ExpandFamily<TCAFlatH1D>(experiment, spec, gainShifts);
+    }
+    return nHistograms;
+}
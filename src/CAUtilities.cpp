@@ -1,8 +1,13 @@
 // C++ Includes
+#include <algorithm>
 #include <chrono>
+#include <exception>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 #include <thread>
 #include <vector>
 
@@ -17,10 +22,29 @@ CAUtilities::Args CAUtilities::ParseArguments(int argc, char* argv[])
 {
     if (argc < 3)
     {
-        printf("Usage: %s [options] <run_file_name> <output_file_name>\n\n", argv[0]);
+        printf("Usage: %s [options] <run_file_name> <output_file_name>\n", argv[0]);
+        printf("       <run_file_name> may be a run tree (.root) or an MVME listfile (" LISTFILE_EXTENSION ")\n");
+        printf("       With --runs, <run_file_name> is the run directory or a pattern such as run%%03d.root\n\n");
         std::cout << "Options:\n"
                   << "  --caldir=<path>    Directory containing calibration files (default: current directory)\n"
                   << "  --gsfile=<path>    File containing gain shift data (default: 70Ge_default.cags)\n"
+                  << "  --block=<n>        Entries read at once per event block, 0 reads entry by entry (default: " << kDefaultBlockSize << ")\n"
+                  << "  --io-threads=<n>   Threads reading and decompressing blocks ahead of the workers, 0 reads inline (default: " << kDefaultIOThreads << ")\n"
+                  << "  --prefetch=<n>     Decoded blocks queued ahead of the workers (default: " << kDefaultPrefetchDepth << ")\n"
+                  << "  --fill-buffer=<n>  Histogram fills buffered per thread and applied histogram by histogram, 0 fills directly (default: " << kDefaultFillBufferSize << ")\n"
+                  << "  --build=<ticks>    Build events from a free-running listfile, merging module readouts within this many timestamp ticks\n"
+                  << "  --pileup=<policy>  Piled-up channels: keep, tag (flag them) or reject (blank them before any histogram) (default: keep)\n"
+                  << "  --multiplicity     Build per-event hit lists and sort the hit multiplicity of every module\n"
+                  << "  --spec=<path>      Histogram specification file, expanded into per-channel and per-detector spectra instead of the built-in ones\n"
+                  << "  --cache=<path>     Hit cache of the run, sorted from if it exists and written during the sort otherwise\n"
+                  << "  --snapshot=<s>     Write the histograms sorted so far every s seconds to <output_file_name> with " SNAPSHOT_EXTENSION "\n"
+                  << "  --snapshot-entries=<n> As --snapshot, every n sorted entries\n"
+                  << "  --index=<path>     Entry index of multiplicity classes, written during the sort or read with --select\n"
+                  << "  --select=<classes> Only sort entries with these detectors, one letter each: g (clover crystal), c (CeBr), p (position)\n"
+                  << "                     e.g. gg or gc, the index defaults to <run_file_name>" ENTRY_INDEX_EXTENSION "\n"
+                  << "  --runs=<list>      Sort several runs, e.g. 12-87 or 12,14,20-25; output, gain shift and cache names get the run number\n"
+                  << "  --parallel=<n>     Runs sorted side by side with --runs (default: 2)\n"
+                  << "  --sum              Write the sum of all runs to <output_file_name> instead of one file per run\n"
                   << std::endl;
         exit(EXIT_FAILURE);
     }
@@ -28,15 +52,66 @@ CAUtilities::Args CAUtilities::ParseArguments(int argc, char* argv[])
     Args args;
     args.calibrationDir = "."; // Default to current directory
     args.gainShiftFile = "";   // Default gain shift file
+    args.blockSize = kDefaultBlockSize;
+    args.ioThreads = kDefaultIOThreads;
+    args.prefetchDepth = kDefaultPrefetchDepth;
+    args.fillBufferSize = kDefaultFillBufferSize;
+    args.coincidenceWindow = kDefaultCoincidenceWindow;
+    args.pileUpPolicy = "keep";
+    args.snapshotInterval = 0.0;
+    args.snapshotEntries = 0;
+    args.runNumber = -1;
+    args.sumRuns = false;
+    args.concurrentRuns = 2;
+    args.multiplicity = false;
 
     // Parse named arguments
     for (int i = 1; i < argc - 2; ++i)
     {
         std::string arg(argv[i]);
-        if (arg.find("--caldir=") == 0)
-            args.calibrationDir = arg.substr(9);
-        else if (arg.find("--gsfile=") == 0)
-            args.gainShiftFile = arg.substr(9);
+        try
+        {
+            if (arg.find("--caldir=") == 0)
+                args.calibrationDir = arg.substr(9);
+            else if (arg.find("--gsfile=") == 0)
+                args.gainShiftFile = arg.substr(9);
+            else if (arg.find("--block=") == 0)
+                args.blockSize = std::stoul(arg.substr(8));
+            else if (arg.find("--io-threads=") == 0)
+                args.ioThreads = std::stoul(arg.substr(13));
+            else if (arg.find("--prefetch=") == 0)
+                args.prefetchDepth = std::stoul(arg.substr(11));
+            else if (arg.find("--fill-buffer=") == 0)
+                args.fillBufferSize = std::stoul(arg.substr(14));
+            else if (arg.find("--build=") == 0)
+                args.coincidenceWindow = std::stod(arg.substr(8));
+            else if (arg.find("--pileup=") == 0)
+                args.pileUpPolicy = arg.substr(9);
+            else if (arg.find("--snapshot=") == 0)
+                args.snapshotInterval = std::stod(arg.substr(11));
+            else if (arg.find("--snapshot-entries=") == 0)
+                args.snapshotEntries = std::stoull(arg.substr(19));
+            else if (arg.find("--spec=") == 0)
+                args.specFileName = arg.substr(7);
+            else if (arg.find("--cache=") == 0)
+                args.hitCacheFileName = arg.substr(8);
+            else if (arg.find("--index=") == 0)
+                args.entryIndexFileName = arg.substr(8);
+            else if (arg.find("--select=") == 0)
+                args.selection = arg.substr(9);
+            else if (arg.find("--runs=") == 0)
+                args.runNumbers = ParseRunList(arg.substr(7));
+            else if (arg.find("--parallel=") == 0)
+                args.concurrentRuns = std::max(1UL, std::stoul(arg.substr(11)));
+            else if (arg == "--sum")
+                args.sumRuns = true;
+            else if (arg == "--multiplicity")
+                args.multiplicity = true;
+        }
+        catch (const std::logic_error&) // std::stoul and std::stod throw std::invalid_argument and std::out_of_range
+        {
+            throw std::runtime_error("[ERROR] Invalid value in option " + arg + ", run " + argv[0] + " without arguments for the usage");
+        }
     }
 
     args.runFileName = argv[argc - 2];
@@ -51,11 +126,76 @@ void CAUtilities::PrintConfiguration(const Args& args)
     std::cout << "Calibration directory: " << args.calibrationDir << std::endl;
     std::cout << "Gain-shift file: " << args.gainShiftFile << std::endl;
     std::cout << "Run file: " << args.runFileName << std::endl;
+    if (!args.runNumbers.empty())
+    {
+        std::cout << "Runs: " << args.runNumbers.size() << " (" << args.runNumbers.front() << " to " << args.runNumbers.back() << "), " << args.concurrentRuns << " at a time" << std::endl;
+        std::cout << "Output: " << (args.sumRuns ? "summed" : "per run") << std::endl;
+    }
     std::cout << "Output file: " << args.outputFileName << std::endl;
+    if (args.coincidenceWindow >= 0)
+        std::cout << "Event building window: " << args.coincidenceWindow << " ticks" << std::endl;
+    std::cout << "Pile-up: " << args.pileUpPolicy << std::endl;
+    if (args.snapshotInterval > 0)
+        std::cout << "Snapshots: every " << args.snapshotInterval << " s" << std::endl;
+    if (args.snapshotEntries > 0)
+        std::cout << "Snapshots: every " << args.snapshotEntries << " entries" << std::endl;
+    std::cout << "Histograms: " << (args.specFileName.empty() ? "built-in" : args.specFileName) << std::endl;
+    std::cout << "Multiplicity spectra: " << (args.multiplicity ? "on" : "off") << std::endl;
+    std::cout << "Hit cache: " << (args.hitCacheFileName.empty() ? "none" : args.hitCacheFileName) << std::endl;
+    if (!args.selection.empty())
+        std::cout << "Selection: " << args.selection << std::endl;
+    else if (!args.entryIndexFileName.empty())
+        std::cout << "Entry index: " << args.entryIndexFileName << std::endl;
     std::cout << "Max Threads: " << kMaxThreads << std::endl;
+    std::cout << "Block Size: " << args.blockSize << std::endl;
+    std::cout << "I/O Threads: " << args.ioThreads << " (" << args.prefetchDepth << " blocks ahead)" << std::endl;
+    std::cout << "Fill Buffer: " << (args.fillBufferSize > 0 ? std::to_string(args.fillBufferSize) + " fills" : std::string("off")) << std::endl;
     std::cout << "--------------------------------------------------------" << std::endl;
 }
 
+std::vector<int> CAUtilities::ParseRunList(const std::string& runList)
+{
+    std::vector<int> runNumbers;
+    std::istringstream iss(runList);
+    std::string item;
+    while (std::getline(iss, item, ','))
+    {
+        if (item.empty())
+            continue;
+        try
+        {
+            // A dash after the first character separates a range, so single runs may not be negative anyway
+            const size_t dash = item.find('-', 1);
+            const int first = std::stoi(item.substr(0, dash));
+            const int last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+            if (last < first)
+            {
+                throw std::runtime_error("[ERROR] Run range " + item + " ends before it starts");
+            }
+            for (int run = first; run <= last; run++)
+                runNumbers.push_back(run);
+        }
+        catch (const std::logic_error&)
+        {
+            throw std::runtime_error("[ERROR] Could not parse run list " + runList);
+        }
+    }
+    std::sort(runNumbers.begin(), runNumbers.end());
+    runNumbers.erase(std::unique(runNumbers.begin(), runNumbers.end()), runNumbers.end());
+    return runNumbers;
+}
+
+std::string CAUtilities::GetRunFileName(const std::string& name, int runNumber)
+{
+    if (name.find('%') != std::string::npos)
+        return Form(name.c_str(), runNumber);
+    if (std::filesystem::is_directory(name))
+        return (std::filesystem::path(name) / Form(RUN_FILE_NAME_TEMPLATE, runNumber)).string();
+
+    std::filesystem::path path(name);
+    return (path.parent_path() / Form("%s_run%03d%s", path.stem().c_str(), runNumber, path.extension().c_str())).string();
+}
+
 void CAUtilities::DisplayProgressBar(std::atomic<uint64_t>& processedEntries, uint64_t totalEntries)
 {
     const int barWidth = 50; // Width of the progress bar
@@ -85,6 +225,45 @@ void CAUtilities::DisplayProgressBar(std::atomic<uint64_t>& processedEntries, ui
     std::cout << "] 100% (" << totalEntries << "/" << totalEntries << ")\n";
 }
 
+void CAUtilities::ParallelFor(size_t n, unsigned int nThreads, const std::function<void(size_t)>& func)
+{
+    nThreads = static_cast<unsigned int>(std::min<size_t>(nThreads, n));
+    if (nThreads <= 1)
+    {
+        for (size_t i = 0; i < n; i++)
+            func(i);
+        return;
+    }
+
+    std::atomic<size_t> next = 0;
+    std::exception_ptr error;
+    std::mutex errorMutex;
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < nThreads; t++)
+    {
+        threads.emplace_back([&]()
+                             {
+            for (size_t i; (i = next++) < n;)
+            {
+                try
+                {
+                    func(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    next = n; // Stop handing out work
+                }
+            } });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    if (error)
+        std::rethrow_exception(error);
+}
+
 std::vector<std::vector<std::vector<double>>> CAUtilities::ReadCAFile(const std::string& fileName)
 {
     std::vector<std::vector<std::vector<double>>> data;
@@ -0,0 +1,26 @@
+// Standard C++ includes
+#include <cstdio>
+
+// ROOT includes
+
+// Project includes
+#include "TCAChannel.hpp"
+
+TCAChannel::TCAChannel()
+    : TCAChannel("", "", "")
+{
+}
+
+TCAChannel::TCAChannel(const char* name, const char* title, const char* type)
+    : TCAHistogramOwner(name, title), fChannelID(fgChannelIDCounter++), fType(type)
+{
+}
+
+TCAChannel::~TCAChannel()
+{
+}
+
+void TCAChannel::PrintInfo() const
+{
+    printf("Channel %zu: %s (%s), type %s, %d histograms\n", fChannelID, GetName(), GetTitle(), fType.c_str(), fHistograms.GetEntriesFast());
+}
@@ -0,0 +1,41 @@
+// Standard C++ includes
+#include <cstdio>
+
+// ROOT includes
+#include <TString.h>
+
+// Project includes
+#include "TCAChannel.hpp"
+#include "TCADAQModule.hpp"
+#include "TCADetector.hpp"
+
+TCADAQModule::TCADAQModule()
+    : TCADAQModule("", "", "")
+{
+}
+
+TCADAQModule::TCADAQModule(const char* name, const char* title, const char* type)
+    : TCAHistogramOwner(name, title), fType(type), fModuleID(fgModuleIDCounter++), fChannelCount(kMDPP16Channels), fChannels(), fDetectors()
+{
+    for (size_t channel = 0; channel < fChannelCount; channel++)
+    {
+        fChannels.push_back(std::make_unique<TCAChannel>(Form("%s_ch%02zu", name, channel), Form("%s Channel %zu", title, channel), type));
+    }
+}
+
+TCADAQModule::~TCADAQModule()
+{
+}
+
+TCADetector* TCADAQModule::AddDetector(const char* name, const char* title)
+{
+    fDetectors.push_back(std::make_unique<TCADetector>(name, title));
+    return fDetectors.back().get();
+}
+
+void TCADAQModule::PrintInfo() const
+{
+    printf("Module %zu: %s (%s), type %s, %zu channels, %zu detectors, %d histograms\n", fModuleID, GetName(), GetTitle(), fType.c_str(), fChannelCount, fDetectors.size(), fHistograms.GetEntriesFast());
+    for (const auto& detector : fDetectors)
+        detector->PrintInfo();
+}
@@ -0,0 +1,35 @@
+// Standard C++ includes
+#include <cstdio>
+
+// ROOT includes
+
+// Project includes
+#include "TCAChannel.hpp"
+#include "TCADetector.hpp"
+
+TCADetector::TCADetector()
+    : TCADetector("", "")
+{
+}
+
+TCADetector::TCADetector(const char* name)
+    : TCADetector(name, name)
+{
+}
+
+TCADetector::TCADetector(const char* name, const char* title)
+    : TCAHistogramOwner(name, title), fDetectorID(fgDetectorIDCounter++), fChannels()
+{
+}
+
+TCADetector::~TCADetector()
+{
+}
+
+void TCADetector::PrintInfo() const
+{
+    printf("Detector %zu: %s (%s), %d histograms, channels:", fDetectorID, GetName(), GetTitle(), fHistograms.GetEntriesFast());
+    for (const auto channel : fChannels)
+        printf(" %s", channel->GetName());
+    printf("\n");
+}
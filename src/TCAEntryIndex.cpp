@@ -0,0 +1,157 @@
+// Standard C++ includes
+#include <algorithm>
+#include <bitset>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+// ROOT includes
+#include <TString.h>
+
+// Project includes
+#include "CAConfiguration.hpp"
+#include "TCAEntryIndex.hpp"
+
+namespace
+{
+    // Detector class of a kModuleClasses letter, -1 for letters no class uses
+    int GetClassIndex(char letter)
+    {
+        const auto it = std::find(TCAEntryIndex::kClassLetters.begin(), TCAEntryIndex::kClassLetters.end(), letter);
+        return it == TCAEntryIndex::kClassLetters.end() ? -1 : static_cast<int>(it - TCAEntryIndex::kClassLetters.begin());
+    }
+} // namespace
+
+TCAEntryIndex::TCAEntryIndex(Long64_t entries, const std::string& runFileName)
+    : fSourceName(CAHitCache::GetSourceName(runFileName)), fClasses(std::max<Long64_t>(0, entries), 0)
+{
+}
+
+TCAEntryIndex::TCAEntryIndex(const std::string& fileName)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("[ERROR] Could not open entry index " + fileName);
+    }
+    CAEntryIndex::FileHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 && std::memcmp(header.fMagic, CAEntryIndex::kMagic, sizeof(header.fMagic)) == 0;
+    if (valid && header.fVersion == CAEntryIndex::kVersion)
+    {
+        header.fSourceName[CAHitCache::kSourceNameLength - 1] = '\0';
+        fSourceName = header.fSourceName;
+        fClasses.resize(header.fEntries);
+        valid = fread(fClasses.data(), 1, fClasses.size(), file) == fClasses.size();
+    }
+    fclose(file);
+    if (!valid)
+    {
+        throw std::runtime_error("[ERROR] Entry index " + fileName + " is truncated or not an entry index");
+    }
+    if (header.fVersion != CAEntryIndex::kVersion)
+    {
+        throw std::runtime_error(Form("[ERROR] Entry index %s has version %u, expected %u", fileName.c_str(), header.fVersion, CAEntryIndex::kVersion));
+    }
+}
+
+bool TCAEntryIndex::Matches(Long64_t entry, const Selection& selection) const
+{
+    for (size_t detectorClass = 0; detectorClass < kNClasses; detectorClass++)
+    {
+        if (GetMultiplicity(entry, static_cast<DetectorClass>(detectorClass)) < selection[detectorClass])
+            return false;
+    }
+    return true;
+}
+
+Long64_t TCAEntryIndex::CountSelected(const Selection& selection) const
+{
+    Long64_t nSelected = 0;
+    for (Long64_t entry = 0; entry < GetEntries(); entry++)
+        nSelected += Matches(entry, selection);
+    return nSelected;
+}
+
+std::vector<TCAEntryIndex::EntryRange> TCAEntryIndex::GetSelectedRanges(const Selection& selection, Long64_t maxGap) const
+{
+    // Reading across a short gap is cheaper than starting a new read, so nearby selected entries share a span
+    std::vector<EntryRange> ranges;
+    for (Long64_t entry = 0; entry < GetEntries(); entry++)
+    {
+        if (!Matches(entry, selection))
+            continue;
+        if (!ranges.empty() && entry - ranges.back().second <= maxGap)
+            ranges.back().second = entry + 1;
+        else
+            ranges.emplace_back(entry, entry + 1);
+    }
+    return ranges;
+}
+
+void TCAEntryIndex::Fill(const TCAEventBlock& block)
+{
+    if (!block.HasFlags())
+        return;
+    if (block.GetFirstEntry() < 0 || block.GetFirstEntry() + static_cast<Long64_t>(block.GetEntries()) > GetEntries())
+    {
+        throw std::runtime_error(Form("[ERROR] Entries %lld-%lld are outside the entry index of %s", block.GetFirstEntry(), block.GetFirstEntry() + static_cast<Long64_t>(block.GetEntries()), fSourceName.c_str()));
+    }
+
+    std::array<int, TCAEvent::kNModules> moduleClasses;
+    for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+        moduleClasses[moduleID] = GetClassIndex(kModuleClasses[moduleID]);
+
+    for (size_t entry = 0; entry < block.GetEntries(); entry++)
+    {
+        std::array<size_t, kNClasses> multiplicities = {};
+        for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+        {
+            if (moduleClasses[moduleID] >= 0)
+                multiplicities[moduleClasses[moduleID]] += std::bitset<16>(block.GetFlags(entry, moduleID, TCAEventBlock::kHitLane)).count();
+        }
+        uint8_t classes = 0;
+        for (size_t detectorClass = 0; detectorClass < kNClasses; detectorClass++)
+            classes |= std::min<size_t>(multiplicities[detectorClass], kClassMax[detectorClass]) << kClassShift[detectorClass];
+        fClasses[block.GetFirstEntry() + entry] = classes;
+    }
+}
+
+void TCAEntryIndex::Write(const std::string& fileName) const
+{
+    CAEntryIndex::FileHeader header = {};
+    std::memcpy(header.fMagic, CAEntryIndex::kMagic, sizeof(header.fMagic));
+    header.fVersion = CAEntryIndex::kVersion;
+    header.fEntries = fClasses.size();
+    std::strncpy(header.fSourceName, fSourceName.c_str(), CAHitCache::kSourceNameLength - 1);
+
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("[ERROR] Could not create entry index " + fileName);
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(fClasses.data(), 1, fClasses.size(), file) == fClasses.size();
+    written = fclose(file) == 0 && written;
+    if (!written)
+    {
+        std::remove(fileName.c_str()); // A short index would gate later sorts on missing entries
+        throw std::runtime_error("[ERROR] Could not write entry index " + fileName);
+    }
+}
+
+TCAEntryIndex::Selection TCAEntryIndex::ParseSelection(const std::string& selection)
+{
+    Selection minimum = {};
+    for (char letter : selection)
+    {
+        const int detectorClass = GetClassIndex(letter);
+        if (detectorClass < 0)
+        {
+            throw std::runtime_error(Form("[ERROR] Unknown detector class '%c' in selection %s, use g (clover), c (CeBr) or p (position signal)", letter, selection.c_str()));
+        }
+        if (++minimum[detectorClass] > kClassMax[detectorClass])
+        {
+            throw std::runtime_error(Form("[ERROR] Selection %s asks for more than %u of class '%c', the entry index saturates there", selection.c_str(), kClassMax[detectorClass], letter));
+        }
+    }
+    return minimum;
+}
@@ -3,17 +3,68 @@
 // ROOT includes
 
 // Project includes
+#include "CAConfiguration.hpp"
 #include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+
+static_assert(kModuleNames.size() == TCAEvent::kNModules, "Module layout in CAConfiguration.hpp does not match TCAEvent::kNModules");
+static_assert(TCAEvent::kPosSig + 1 == TCAEvent::kNModules, "TCAEvent::ModuleID does not cover every module");
 
 TCAEvent::TCAEvent(TCAExperiment *experiment)
     : fExperiment(experiment)
 {
 }
 
-TCAEvent::~TCAEvent()
+TCAEvent::TCAEvent(TCAExperiment *experiment, TTreeReader &reader, const ColumnMask &columns)
+    : fExperiment(experiment)
 {
-    for (auto &ptr : fData)
+    auto tree = reader.GetTree();
+    for (size_t moduleID = 0; moduleID < kNModules; moduleID++)
     {
-        delete ptr;
+        for (size_t filterID = 0; filterID < kNFilters; filterID++)
+        {
+            if (!columns.test(GetColumn(moduleID, filterID)))
+                continue; // No histogram reads this branch, without a reader array TTreeReader never loads it
+            const TString branchName = GetBranchName(moduleID, filterID);
+            if (tree == nullptr || tree->GetBranch(branchName) == nullptr)
+                continue; // Not every module type provides every filter, a reader on a missing branch would invalidate the whole entry
+            auto& readerArray = fReaderArrays[GetColumn(moduleID, filterID)];
+            readerArray = std::make_unique<TTreeReaderArray<double>>(reader, branchName);
+            fData[GetColumn(moduleID, filterID)] = readerArray.get();
+        }
     }
+}
+
+TString TCAEvent::GetBranchName(size_t moduleID, size_t filterID)
+{
+    return Form(BRANCH_NAME_TEMPLATE, kModuleNames[moduleID], kFilterNames[filterID]);
+}
+
+TCAHitView TCAEvent::GetHits() const
+{
+    if (fBlock == nullptr || !fBlock->HasHits())
+        return TCAHitView();
+    return fBlock->Hits(fBlockEntry);
+}
+
+uint64_t TCAEvent::GetFlags(size_t moduleID) const
+{
+    if (fBlock == nullptr || !fBlock->HasFlags())
+        return 0;
+    return fBlock->GetFlags(fBlockEntry, moduleID);
+}
+
+void TCAEvent::SetBlock(const TCAEventBlock *block)
+{
+    fBlock = block;
+    fBlockEntry = 0;
+    for (size_t slot = 0; slot < fBlockData.size(); slot++)
+    {
+        fBlockData[slot] = block != nullptr ? block->GetColumnData(slot) : nullptr;
+        fBlockWidth[slot] = block != nullptr ? block->GetColumnWidth(slot) : 0;
+    }
+}
+
+TCAEvent::~TCAEvent()
+{
 }
\ No newline at end of file
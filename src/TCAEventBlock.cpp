@@ -0,0 +1,270 @@
+// Standard C++ includes
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// ROOT includes
+#include <TLeaf.h>
+#include <TMath.h>
+#include <TString.h>
+
+// Project includes
+#include "TCAEventBlock.hpp"
+
+TCAEventBlock::TCAEventBlock(TTree* tree, size_t capacity, const TCAEvent::ColumnMask& columns)
+    : fTree(tree), fCapacity(std::max<size_t>(1, capacity)), fBulkBuffer(TBuffer::kWrite, kBulkBufferSize)
+{
+    for (size_t column = 0; column < kNColumns; column++)
+    {
+        if (!columns.test(column))
+            continue; // Pruned, the branch's baskets are never read or decompressed
+        const size_t moduleID = column / TCAEvent::kNFilters;
+        const size_t filterID = column % TCAEvent::kNFilters;
+        const TString branchName = TCAEvent::GetBranchName(moduleID, filterID);
+        auto& col = fColumns[column];
+
+        col.fBranch = fTree->GetBranch(branchName);
+        if (col.fBranch == nullptr)
+            continue; // Not every module type provides every filter
+
+        auto leaf = static_cast<TLeaf*>(col.fBranch->GetListOfLeaves()->At(0));
+        col.fPresent = true;
+        col.fWidth = std::max(1, leaf->GetLenStatic());
+        // Bulk reads only handle single, fixed-size leaves, anything else (e.g. split object members) goes through a reader
+        col.fBulk = col.fBranch->SupportsBulkRead() && leaf->GetLeafCount() == nullptr && std::strcmp(leaf->GetTypeName(), "Double_t") == 0;
+        col.fValues.resize(fCapacity * col.fWidth);
+
+        if (col.fBulk)
+        {
+            fNBulkColumns++;
+            continue;
+        }
+        if (!fReader)
+            fReader = std::make_unique<TTreeReader>(fTree);
+        col.fReaderArray = std::make_unique<TTreeReaderArray<double>>(*fReader, branchName);
+    }
+}
+
+TCAEventBlock::TCAEventBlock(const std::array<size_t, kNColumns>& widths, size_t capacity)
+    : fTree(nullptr), fCapacity(std::max<size_t>(1, capacity)), fBulkBuffer(TBuffer::kWrite, kBulkBufferSize)
+{
+    for (size_t column = 0; column < kNColumns; column++)
+    {
+        auto& col = fColumns[column];
+        col.fPresent = widths[column] > 0;
+        col.fWidth = widths[column];
+        col.fValues.resize(fCapacity * col.fWidth);
+    }
+}
+
+TCAEventBlock::~TCAEventBlock()
+{
+    // Reader arrays must go before the reader they are registered with
+    for (auto& column : fColumns)
+        column.fReaderArray.reset();
+}
+
+size_t TCAEventBlock::SetRange(Long64_t firstEntry, Long64_t lastEntry)
+{
+    fFirstEntry = firstEntry;
+    fEntries = static_cast<size_t>(std::clamp<Long64_t>(lastEntry - firstEntry, 0, fCapacity));
+    fHits.clear(); // Hits and flags of the previous range are stale
+    fHitOffsets.clear();
+    fFlags.clear();
+    return fEntries;
+}
+
+void TCAEventBlock::BuildFlags()
+{
+    fFlags.assign(fEntries * TCAEvent::kNModules, 0);
+    for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+    {
+        auto amplitudes = View(moduleID, TCAEvent::kAmplitude);
+        if (!amplitudes.IsValid())
+            amplitudes = View(moduleID, TCAEvent::kIntLong);
+        const auto times = View(moduleID, TCAEvent::kChannelTime);
+        const auto pileUps = View(moduleID, TCAEvent::kPileUp);
+        const size_t nChannels = std::min<size_t>(16, std::max(amplitudes.GetWidth(), pileUps.GetWidth()));
+
+        for (size_t entry = 0; entry < fEntries; entry++)
+        {
+            uint64_t hit = 0, pileUp = 0, noTime = 0;
+            for (size_t channel = 0; channel < nChannels; channel++)
+            {
+                const bool isHit = channel < amplitudes.GetWidth() && amplitudes(entry, channel) > 0; // Empty channels read as NaN or 0
+                hit |= static_cast<uint64_t>(isHit) << channel;
+                pileUp |= static_cast<uint64_t>(channel < pileUps.GetWidth() && pileUps(entry, channel) > 0) << channel;
+                noTime |= static_cast<uint64_t>(isHit && !(channel < times.GetWidth() && !std::isnan(times(entry, channel)))) << channel;
+            }
+            fFlags[entry * TCAEvent::kNModules + moduleID] = hit << kHitLane | pileUp << kPileUpLane | noTime << kNoTimeLane;
+        }
+    }
+}
+
+size_t TCAEventBlock::Compact(const std::vector<bool>& keep)
+{
+    size_t nKept = 0;
+    for (size_t entry = 0; entry < fEntries; entry++)
+    {
+        if (!keep[entry])
+            continue;
+        if (nKept != entry)
+        {
+            for (auto& column : fColumns)
+            {
+                if (column.fPresent)
+                    std::copy_n(column.fValues.begin() + entry * column.fWidth, column.fWidth, column.fValues.begin() + nKept * column.fWidth);
+            }
+        }
+        nKept++;
+    }
+    fEntries = nKept;
+    fHits.clear(); // Built for the old rows
+    fHitOffsets.clear();
+    fFlags.clear();
+    return fEntries;
+}
+
+size_t TCAEventBlock::RejectPileUp()
+{
+    if (!HasFlags())
+        return 0;
+
+    // Everything measured for the channel goes, so hit lists, calibrations and add-back all see an empty channel
+    static constexpr std::array<TCAEvent::FilterID, 4> kChannelFilters = {TCAEvent::kAmplitude, TCAEvent::kChannelTime, TCAEvent::kIntLong, TCAEvent::kIntShort};
+    size_t nRejected = 0;
+    for (size_t entry = 0; entry < fEntries; entry++)
+    {
+        for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+        {
+            uint64_t& flags = fFlags[entry * TCAEvent::kNModules + moduleID];
+            const uint64_t rejected = (flags >> kPileUpLane) & (flags >> kHitLane) & 0xffff;
+            if (rejected == 0)
+                continue;
+            for (auto filterID : kChannelFilters)
+            {
+                auto& column = fColumns[TCAEvent::GetColumn(moduleID, filterID)];
+                if (!column.fPresent)
+                    continue;
+                double* values = column.fValues.data() + entry * column.fWidth;
+                for (size_t channel = 0; channel < std::min<size_t>(16, column.fWidth); channel++)
+                {
+                    if (rejected >> channel & 1)
+                        values[channel] = std::numeric_limits<double>::quiet_NaN();
+                }
+            }
+            flags = (flags & ~(rejected << kHitLane)) | rejected << kRejectedLane;
+            nRejected += std::bitset<16>(rejected).count();
+        }
+    }
+    return nRejected;
+}
+
+void TCAEventBlock::BuildHits(double threshold)
+{
+    fHits.clear();
+    fHitOffsets.resize(fEntries + 1);
+    fHitOffsets[0] = 0;
+    for (size_t entry = 0; entry < fEntries; entry++)
+    {
+        for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+        {
+            // QDC modules have no amplitude, their long integral takes its place
+            auto amplitudes = View(moduleID, TCAEvent::kAmplitude);
+            if (!amplitudes.IsValid())
+                amplitudes = View(moduleID, TCAEvent::kIntLong);
+            if (!amplitudes.IsValid())
+                continue;
+            const auto times = View(moduleID, TCAEvent::kChannelTime);
+            const auto pileUps = View(moduleID, TCAEvent::kPileUp);
+
+            const auto values = amplitudes[entry];
+            for (size_t channel = 0; channel < values.size(); channel++)
+            {
+                if (!(values[channel] > threshold))
+                    continue; // Also drops NaN, which marks an empty channel
+
+                TCAHit hit;
+                hit.fModuleID = static_cast<uint16_t>(moduleID);
+                hit.fChannel = static_cast<uint8_t>(channel);
+                hit.fAmplitude = values[channel];
+                hit.fTime = channel < times.GetWidth() ? times(entry, channel) : std::numeric_limits<double>::quiet_NaN();
+                if (std::isnan(hit.fTime))
+                    hit.fFlags |= TCAHit::kNoTime;
+                if (channel < pileUps.GetWidth() && pileUps(entry, channel) > 0)
+                    hit.fFlags |= TCAHit::kPileUp;
+                fHits.push_back(hit);
+            }
+        }
+        fHitOffsets[entry + 1] = static_cast<uint32_t>(fHits.size());
+    }
+}
+
+size_t TCAEventBlock::Read(Long64_t firstEntry, Long64_t lastEntry)
+{
+    if (fTree == nullptr)
+    {
+        throw std::runtime_error("[ERROR] Event block has no run tree to read from");
+    }
+    if (SetRange(firstEntry, lastEntry) == 0)
+        return 0;
+
+    for (auto& column : fColumns)
+    {
+        if (column.fPresent && column.fBulk)
+            ReadBulkColumn(column, firstEntry, fEntries);
+    }
+    if (fReader)
+        ReadReaderColumns(firstEntry, fEntries);
+
+    return fEntries;
+}
+
+void TCAEventBlock::ReadBulkColumn(Column& column, Long64_t firstEntry, size_t nEntries)
+{
+    auto branch = column.fBranch;
+    size_t filled = 0;
+    while (filled < nEntries)
+    {
+        const Long64_t entry = firstEntry + filled;
+        // The bulk API hands back the whole basket holding the entry, starting from the basket's first entry
+        const Long64_t basketCount = branch->GetBulkRead().GetBulkEntries(entry, fBulkBuffer);
+        if (basketCount <= 0)
+        {
+            throw std::runtime_error(Form("[ERROR] Bulk read of branch %s failed at entry %lld", branch->GetName(), entry));
+        }
+        const Long64_t basket = TMath::BinarySearch(static_cast<Long64_t>(branch->GetWriteBasket() + 1), branch->GetBasketEntry(), entry);
+        const Long64_t skip = entry - branch->GetBasketEntry()[basket];
+        const size_t count = std::min<size_t>(basketCount - skip, nEntries - filled);
+
+        const auto values = reinterpret_cast<const double*>(fBulkBuffer.GetCurrent()) + skip * column.fWidth;
+        std::memcpy(column.fValues.data() + filled * column.fWidth, values, count * column.fWidth * sizeof(double));
+        filled += count;
+    }
+}
+
+void TCAEventBlock::ReadReaderColumns(Long64_t firstEntry, size_t nEntries)
+{
+    for (size_t i = 0; i < nEntries; i++)
+    {
+        const auto status = fReader->SetEntry(firstEntry + i);
+        if (status != TTreeReader::kEntryValid)
+        {
+            throw std::runtime_error(Form("[ERROR] Reading entry %lld failed with status %d", firstEntry + static_cast<Long64_t>(i), status));
+        }
+        for (auto& column : fColumns)
+        {
+            if (!column.fReaderArray)
+                continue;
+            auto& array = *column.fReaderArray;
+            double* dest = column.fValues.data() + i * column.fWidth;
+            const size_t size = std::min<size_t>(array.GetSize(), column.fWidth);
+            for (size_t idx = 0; idx < size; idx++)
+                dest[idx] = array[idx];
+            std::fill(dest + size, dest + column.fWidth, std::numeric_limits<double>::quiet_NaN()); // Missing values read as empty
+        }
+    }
+}
@@ -0,0 +1,201 @@
+// Standard C++ includes
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+
+// ROOT includes
+#include <TString.h>
+
+// Project includes
+#include "TCAEventBuilder.hpp"
+
+TCAEventBuilder::TCAEventBuilder(std::unique_ptr<TCAVirtualBlockSource> source, double coincidenceWindow)
+    : fSource(std::move(source)), fCoincidenceWindow(coincidenceWindow)
+{
+    if (!fSource)
+    {
+        throw std::runtime_error("[ERROR] Event builder needs a source of module readouts");
+    }
+    if (!(fCoincidenceWindow >= 0))
+    {
+        throw std::runtime_error(Form("[ERROR] Invalid coincidence window %g", fCoincidenceWindow));
+    }
+}
+
+size_t TCAEventBuilder::Read(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry) const
+{
+    lastEntry = std::min(lastEntry, GetEntries());
+    if (firstEntry >= lastEntry)
+    {
+        block.SetRange(firstEntry, firstEntry);
+        return 0;
+    }
+
+    // Module timestamps are always needed, the other columns only where the output block keeps them
+    auto widths = fSource->GetColumnWidths();
+    for (size_t column = 0; column < widths.size(); column++)
+    {
+        if (column % TCAEvent::kNFilters != TCAEvent::kModuleTime && block.GetColumnData(column) == nullptr)
+            widths[column] = 0;
+    }
+
+    // Each readout makes at most one event, so the upstream entries of one block rarely overflow it; if they do, take fewer
+    thread_local std::unique_ptr<TCAEventBlock> input;
+    thread_local std::array<size_t, TCAEventBlock::kNColumns> inputWidths{};
+    Long64_t endEntry = std::min<Long64_t>(lastEntry, firstEntry + block.GetCapacity());
+    for (;;)
+    {
+        const Long64_t inputFirst = std::max<Long64_t>(0, firstEntry - kMaxSkew);
+        const Long64_t inputLast = std::min(GetEntries(), endEntry + kMaxSkew);
+        const size_t nInput = static_cast<size_t>(inputLast - inputFirst);
+        if (!input || input->GetCapacity() < nInput || inputWidths != widths)
+        {
+            input = std::make_unique<TCAEventBlock>(widths, std::max(nInput, input ? input->GetCapacity() : 0));
+            inputWidths = widths;
+        }
+        if (fSource->Read(*input, inputFirst, inputLast) != nInput)
+        {
+            throw std::runtime_error(Form("[ERROR] Event builder could not read upstream entries %lld-%lld", inputFirst, inputLast));
+        }
+
+        const size_t nEvents = Build(*input, block, firstEntry, endEntry);
+        if (nEvents <= block.GetCapacity() || endEntry - firstEntry <= 1)
+            break;
+        endEntry = firstEntry + (endEntry - firstEntry) / 2;
+    }
+    return static_cast<size_t>(endEntry - firstEntry);
+}
+
+std::vector<TCAEventBuilder::Readout> TCAEventBuilder::MergeReadouts(const TCAEventBlock& input) const
+{
+    // One stream per module, each close to time order already, merged through a min-heap of the stream heads
+    std::array<std::vector<Readout>, TCAEvent::kNModules> streams;
+    size_t nReadouts = 0;
+    for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+    {
+        const auto times = input.View(moduleID, TCAEvent::kModuleTime);
+        if (!times.IsValid())
+            continue;
+        for (size_t row = 0; row < input.GetEntries(); row++)
+        {
+            if (!std::isnan(times(row)))
+                streams[moduleID].push_back({times(row), static_cast<uint32_t>(row), static_cast<uint16_t>(moduleID)});
+        }
+        std::stable_sort(streams[moduleID].begin(), streams[moduleID].end(), [](const Readout& a, const Readout& b) { return a.fTime < b.fTime; });
+        nReadouts += streams[moduleID].size();
+    }
+
+    typedef std::tuple<double, uint16_t, size_t> Head; // Time, module, position in the module's stream
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    for (size_t moduleID = 0; moduleID < streams.size(); moduleID++)
+    {
+        if (!streams[moduleID].empty())
+            heads.emplace(streams[moduleID][0].fTime, moduleID, 0);
+    }
+
+    std::vector<Readout> merged;
+    merged.reserve(nReadouts);
+    while (!heads.empty())
+    {
+        const auto [time, moduleID, idx] = heads.top();
+        heads.pop();
+        merged.push_back(streams[moduleID][idx]);
+        if (idx + 1 < streams[moduleID].size())
+            heads.emplace(streams[moduleID][idx + 1].fTime, moduleID, idx + 1);
+    }
+    return merged;
+}
+
+double TCAEventBuilder::GetCut(const std::vector<Readout>& readouts, Long64_t entry, Long64_t firstInput, bool lowerEdge) const
+{
+    // Only readouts of upstream entries [entry - kMaxSkew, entry + kMaxSkew) count, both neighbours of the boundary see them all
+    auto nearBoundary = [&](const Readout& readout)
+    {
+        const Long64_t readoutEntry = firstInput + readout.fRow;
+        return readoutEntry >= entry - kMaxSkew && readoutEntry < entry + kMaxSkew;
+    };
+    double firstAfter = std::numeric_limits<double>::infinity();
+    double lastBefore = -std::numeric_limits<double>::infinity();
+    for (const auto& readout : readouts)
+    {
+        if (!nearBoundary(readout))
+            continue;
+        if (firstInput + readout.fRow >= entry)
+            firstAfter = std::min(firstAfter, readout.fTime);
+        else
+            lastBefore = std::max(lastBefore, readout.fTime);
+    }
+    if (std::isinf(firstAfter))
+    {
+        // Nothing after the boundary: everything seen before it stays on the left. With nothing on either side each neighbour
+        // keeps everything it sees, by the skew limit the readouts they see cannot overlap.
+        if (std::isinf(lastBefore))
+            return lowerEdge ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+        return std::nextafter(lastBefore, std::numeric_limits<double>::infinity());
+    }
+
+    // First readout at or after the earliest timestamp behind the boundary that opens a gap longer than the window
+    double previous = -std::numeric_limits<double>::infinity();
+    for (const auto& readout : readouts)
+    {
+        if (!nearBoundary(readout))
+            continue;
+        if (readout.fTime >= firstAfter && readout.fTime - previous > fCoincidenceWindow)
+            return readout.fTime;
+        previous = readout.fTime;
+    }
+    return firstAfter; // Busy all through the boundary, the event around it is split
+}
+
+size_t TCAEventBuilder::Build(const TCAEventBlock& input, TCAEventBlock& output, Long64_t firstEntry, Long64_t lastEntry) const
+{
+    const Long64_t firstInput = input.GetFirstEntry();
+    const auto readouts = MergeReadouts(input);
+    const double cutLow = firstEntry <= 0 ? -std::numeric_limits<double>::infinity() : GetCut(readouts, firstEntry, firstInput, true);
+    const double cutHigh = lastEntry >= GetEntries() ? std::numeric_limits<double>::infinity() : GetCut(readouts, lastEntry, firstInput, false);
+
+    const size_t capacity = output.GetCapacity();
+    output.SetRange(firstEntry, firstEntry + static_cast<Long64_t>(capacity));
+
+    size_t nEvents = 0;
+    double eventStart = 0;
+    unsigned int eventModules = 0; // Modules already in the current event, one readout per module and event
+    for (const auto& readout : readouts)
+    {
+        if (readout.fTime < cutLow || readout.fTime >= cutHigh)
+            continue; // Built by the neighbouring range
+        if (nEvents == 0 || readout.fTime - eventStart > fCoincidenceWindow || (eventModules >> readout.fModuleID & 1))
+        {
+            eventStart = readout.fTime;
+            eventModules = 0;
+            if (++nEvents <= capacity)
+            {
+                for (size_t column = 0; column < TCAEventBlock::kNColumns; column++)
+                {
+                    if (double* data = output.GetMutableColumnData(column))
+                        std::fill_n(data + (nEvents - 1) * output.GetColumnWidth(column), output.GetColumnWidth(column), std::numeric_limits<double>::quiet_NaN());
+                }
+            }
+        }
+        eventModules |= 1U << readout.fModuleID;
+        if (nEvents > capacity)
+            continue; // Only counting, the caller retries with fewer upstream entries
+
+        for (size_t filterID = 0; filterID < TCAEvent::kNFilters; filterID++)
+        {
+            const size_t column = TCAEvent::GetColumn(readout.fModuleID, filterID);
+            double* data = output.GetMutableColumnData(column);
+            const double* source = input.GetColumnData(column);
+            if (data == nullptr || source == nullptr)
+                continue;
+            const size_t width = std::min(output.GetColumnWidth(column), input.GetColumnWidth(column));
+            std::copy_n(source + readout.fRow * input.GetColumnWidth(column), width, data + (nEvents - 1) * output.GetColumnWidth(column));
+        }
+    }
+
+    output.SetRange(firstEntry, firstEntry + static_cast<Long64_t>(std::min(nEvents, capacity)));
+    return nEvents;
+}
@@ -0,0 +1,79 @@
+// Standard C++ includes
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+// ROOT includes
+#include <TString.h>
+
+// Project includes
+#include "CAConfiguration.hpp"
+#include "TCAEventPool.hpp"
+
+TCAEventPool::TCAEventPool(TCAExperiment* experiment, const std::string& runFileName, size_t nSlots, const TCAEvent::ColumnMask& columns)
+    : fExperiment(experiment), fRunFileName(runFileName), fColumns(columns), fSlots(std::max<size_t>(1, nSlots))
+{
+}
+
+TCAEventPool::~TCAEventPool()
+{
+}
+
+bool TCAEventPool::IsCompatible(const std::string& runFileName, size_t nSlots, const TCAEvent::ColumnMask& columns) const
+{
+    return runFileName == fRunFileName && nSlots <= fSlots.size() && columns == fColumns;
+}
+
+TTree* TCAEventPool::GetTree(size_t slot)
+{
+    auto& poolSlot = fSlots.at(slot);
+    if (poolSlot.fTree != nullptr)
+        return poolSlot.fTree;
+
+    // Each slot opens its own copy of the run, TTree reading is not thread-safe
+    poolSlot.fFile.reset(TFile::Open(fRunFileName.c_str(), "READ"));
+    if (!poolSlot.fFile || poolSlot.fFile->IsZombie())
+    {
+        throw std::runtime_error("[ERROR] Could not open run file " + fRunFileName + " for reader slot " + std::to_string(slot));
+    }
+    poolSlot.fTree = poolSlot.fFile->Get<TTree>(RUN_TREE_NAME);
+    if (poolSlot.fTree == nullptr)
+    {
+        throw std::runtime_error("[ERROR] Could not read tree " RUN_TREE_NAME " from " + fRunFileName + " for reader slot " + std::to_string(slot));
+    }
+
+    // The cache learns which branches to prefetch from the first entries it sees, and starts over whenever the range
+    // moves. The branches are known up front, so they are registered once and learning is switched off.
+    for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+    {
+        for (size_t filterID = 0; filterID < TCAEvent::kNFilters; filterID++)
+        {
+            const TString branchName = TCAEvent::GetBranchName(moduleID, filterID);
+            if (fColumns.test(TCAEvent::GetColumn(moduleID, filterID)) && poolSlot.fTree->GetBranch(branchName) != nullptr)
+                poolSlot.fTree->AddBranchToCache(branchName, false);
+        }
+    }
+    poolSlot.fTree->StopCacheLearningPhase();
+    return poolSlot.fTree;
+}
+
+TTreeReader& TCAEventPool::GetReader(size_t slot)
+{
+    auto& poolSlot = fSlots.at(slot);
+    if (!poolSlot.fReader)
+        poolSlot.fReader = std::make_unique<TTreeReader>(GetTree(slot));
+    return *poolSlot.fReader;
+}
+
+TCAEvent& TCAEventPool::GetEvent(size_t slot)
+{
+    auto& poolSlot = fSlots.at(slot);
+    if (!poolSlot.fEvent)
+        poolSlot.fEvent = std::make_unique<TCAEvent>(fExperiment, GetReader(slot), fColumns);
+    return *poolSlot.fEvent;
+}
+
+TTreeReader::EEntryStatus TCAEventPool::SetRange(size_t slot, Long64_t firstEntry, Long64_t lastEntry)
+{
+    return GetReader(slot).SetEntriesRange(firstEntry, lastEntry);
+}
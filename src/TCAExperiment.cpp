@@ -0,0 +1,817 @@
+// Standard C++ includes
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+// ROOT includes
+#include <TFile.h>
+#include <TROOT.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+
+// Project includes
+#include "CAUtilities.hpp"
+#include "TCAChannel.hpp"
+#include "TCADAQModule.hpp"
+#include "TCADetector.hpp"
+#include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+#include "TCAEventBuilder.hpp"
+#include "TCAEventPool.hpp"
+#include "TCAFillBuffer.hpp"
+#include "TCAEntryIndex.hpp"
+#include "TCAExperiment.hpp"
+#include "TCAHitCache.hpp"
+#include "TCAListfileReader.hpp"
+#include "TCASnapshotWriter.hpp"
+#include "TCAWorkQueue.hpp"
+
+TCAExperiment::TCAExperiment(const char* name, const char* title)
+    : TCAHistogramOwner(name, title), fModules()
+{
+}
+
+TCAExperiment::~TCAExperiment()
+{
+}
+
+std::vector<TCAVirtualHistogram*> TCAExperiment::GetHistograms() const
+{
+    std::vector<TCAVirtualHistogram*> histograms;
+    for (auto owner : GetHistogramOwners())
+        owner->AppendHistograms(histograms);
+    return histograms;
+}
+
+std::vector<TCAHistogramOwner*> TCAExperiment::GetHistogramOwners() const
+{
+    std::vector<TCAHistogramOwner*> owners = {const_cast<TCAExperiment*>(this)};
+    for (const auto& module : fModules)
+    {
+        owners.push_back(module.get());
+        for (size_t channel = 0; channel < module->GetChannelCount(); channel++)
+            owners.push_back(module->GetChannel(channel));
+        for (size_t detector = 0; detector < module->GetDetectorCount(); detector++)
+            owners.push_back(module->GetDetector(detector));
+    }
+    return owners;
+}
+
+std::vector<std::pair<TCAHistogramOwner*, std::string>> TCAExperiment::GetOwnerDirectories() const
+{
+    std::vector<std::pair<TCAHistogramOwner*, std::string>> directories = {{const_cast<TCAExperiment*>(this), ""}};
+    for (const auto& module : fModules)
+    {
+        const std::string moduleDirectory = module->GetName();
+        directories.emplace_back(module.get(), moduleDirectory);
+        for (size_t detector = 0; detector < module->GetDetectorCount(); detector++)
+            directories.emplace_back(module->GetDetector(detector), moduleDirectory + "/" + module->GetDetector(detector)->GetName());
+        for (size_t channel = 0; channel < module->GetChannelCount(); channel++)
+            directories.emplace_back(module->GetChannel(channel), moduleDirectory + "/" + module->GetChannel(channel)->GetName());
+    }
+    return directories;
+}
+
+TCAEvent::ColumnMask TCAExperiment::GetActiveColumns() const
+{
+    // A hit cache stands in for the run in later sorts, which may need any branch
+    if (fHitCacheWriter)
+        return TCAEvent::ColumnMask().set();
+
+    TCAEvent::ColumnMask columns;
+    for (auto owner : GetHistogramOwners())
+        owner->AppendDependencies(columns);
+    // Only the modules of this setup, a run may hold modules the configuration leaves out
+    for (const auto& module : fModules)
+    {
+        const size_t moduleID = module->GetModuleID();
+        if (fPileUpPolicy != TCAEventBlock::kKeepPileUp)
+            columns.set(TCAEvent::GetColumn(moduleID, TCAEvent::kPileUp));
+        if (fBuildHits)
+        {
+            for (auto filterID : {TCAEvent::kAmplitude, TCAEvent::kIntLong, TCAEvent::kChannelTime, TCAEvent::kPileUp})
+                columns.set(TCAEvent::GetColumn(moduleID, filterID));
+        }
+        if (fWriteEntryIndex)
+        {
+            for (auto filterID : {TCAEvent::kAmplitude, TCAEvent::kIntLong})
+                columns.set(TCAEvent::GetColumn(moduleID, filterID));
+        }
+    }
+    return columns;
+}
+
+void TCAExperiment::SetSelection(const std::string& selection)
+{
+    fSelectionClasses = TCAEntryIndex::ParseSelection(selection); // Throws before any run is opened
+    fSelection = selection;
+}
+
+TCADAQModule* TCAExperiment::AddModule(const char* name, const char* title, const char* type, size_t moduleID)
+{
+    if (moduleID >= TCAEvent::kNModules)
+    {
+        throw std::runtime_error(Form("[ERROR] Module ID %zu of module %s is out of range, events hold %d modules", moduleID, name, TCAEvent::kNModules));
+    }
+    fModules.push_back(std::make_unique<TCADAQModule>(name, title, type));
+    fModules.back()->SetModuleID(moduleID); // Module ID is the index of the module in TCAEvent, not the creation order
+    return fModules.back().get();
+}
+
+void TCAExperiment::SetSnapshots(const std::string& fileName, double interval, uint64_t entryInterval)
+{
+    fSnapshotFileName = fileName;
+    fSnapshotInterval = std::max(0.0, interval);
+    fSnapshotEntries = entryInterval;
+}
+
+void TCAExperiment::BuildDetectorTree()
+{
+    for (size_t moduleID = 0; moduleID < kModuleNames.size(); moduleID++)
+    {
+        if (!kProcessModule[moduleID])
+            continue;
+
+        auto module = AddModule(kModuleNames[moduleID], kModuleNames[moduleID], kModuleTypes[moduleID], moduleID);
+        const size_t channelsPerDetector = kChannelsPerDetector[moduleID];
+        for (size_t first = 0; first + channelsPerDetector <= module->GetChannelCount(); first += channelsPerDetector)
+        {
+            const size_t detectorIdx = first / channelsPerDetector;
+            auto detector = module->AddDetector(Form("%s_det%02zu", module->GetName(), detectorIdx), Form("%s Detector %zu", module->GetName(), detectorIdx));
+            for (size_t channel = first; channel < first + channelsPerDetector; channel++)
+                detector->AddChannel(module->GetChannel(channel));
+        }
+    }
+}
+
+void TCAExperiment::OpenRun(const std::string& runFileName)
+{
+    fBlockSource.reset();
+    fHitCacheWriter.reset();
+    fEventPool.reset();
+    fEntryIndex.reset();
+    fWriteEntryIndex = false;
+    fRunFileName = runFileName;
+    fClusters.clear();
+    fEntries = 0;
+
+    // A hit cache made from this run replaces the run itself, a cache written while building events holds the built events
+    if (!fHitCacheFileName.empty() && std::filesystem::exists(fHitCacheFileName))
+    {
+        try
+        {
+            auto hitCache = std::make_unique<TCAHitCacheReader>(fHitCacheFileName);
+            if (CAHitCache::GetSourceName(runFileName) == hitCache->GetSourceName())
+            {
+                fEntries = hitCache->GetEntries();
+                fBlockSource = std::move(hitCache);
+                printf("[INFO] Sorting run %s from hit cache %s with %lld entries\n", fRunFileName.c_str(), fHitCacheFileName.c_str(), fEntries);
+                OpenEntryIndex();
+                return;
+            }
+            printf("[WARN] Hit cache %s was made from %s, it will be rebuilt from %s\n", fHitCacheFileName.c_str(), hitCache->GetSourceName(), fRunFileName.c_str());
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            std::cerr << "[WARN] Hit cache " << fHitCacheFileName << " will be rebuilt" << std::endl;
+        }
+    }
+
+    if (TCAListfileReader::IsListfile(runFileName))
+    {
+        fBlockSource = std::make_unique<TCAListfileReader>(runFileName);
+        fEntries = fBlockSource->GetEntries();
+        printf("[INFO] Opened listfile %s with %lld events\n", fRunFileName.c_str(), fEntries);
+        if (fCoincidenceWindow >= 0)
+        {
+            fBlockSource = std::make_unique<TCAEventBuilder>(std::move(fBlockSource), fCoincidenceWindow);
+            printf("[INFO] Building events from module readouts within %g timestamp ticks\n", fCoincidenceWindow);
+        }
+    }
+    else
+    {
+        auto runFile = std::unique_ptr<TFile>(TFile::Open(runFileName.c_str(), "READ"));
+        if (!runFile || runFile->IsZombie())
+        {
+            throw std::runtime_error("[ERROR] Could not open run file " + runFileName);
+        }
+        auto tree = runFile->Get<TTree>(RUN_TREE_NAME);
+        if (tree == nullptr)
+        {
+            throw std::runtime_error("[ERROR] Run file " + runFileName + " does not contain a tree named " RUN_TREE_NAME);
+        }
+        if (fCoincidenceWindow >= 0)
+        {
+            throw std::runtime_error("[ERROR] Events can only be built from listfiles, run tree " + runFileName + " already holds built events");
+        }
+        fEntries = tree->GetEntries();
+
+        // Ranges that split a cluster make two workers decompress the same baskets, so work units follow the clusters
+        auto clusterIter = tree->GetClusterIterator(0);
+        for (Long64_t first = 0; (first = clusterIter()) < fEntries;)
+            fClusters.emplace_back(first, std::min(clusterIter.GetNextEntry(), fEntries));
+        printf("[INFO] Opened run file %s with %lld entries in %zu clusters\n", fRunFileName.c_str(), fEntries, fClusters.size());
+    }
+
+    // A cache stands in for the whole run, one written from the selected entries only would short later sorts
+    if (!fHitCacheFileName.empty() && !fSelection.empty())
+    {
+        printf("[WARN] Hit cache %s is not written by a sort gated on %s\n", fHitCacheFileName.c_str(), fSelection.c_str());
+    }
+    else if (!fHitCacheFileName.empty())
+    {
+        fHitCacheWriter = std::make_unique<TCAHitCacheWriter>(fHitCacheFileName, fRunFileName);
+        printf("[INFO] Writing hit cache %s during the sort\n", fHitCacheFileName.c_str());
+    }
+    OpenEntryIndex();
+}
+
+void TCAExperiment::OpenEntryIndex()
+{
+    // Built events are numbered as they are built, so they cannot be matched to an index of the run's entries
+    const bool buildsEvents = dynamic_cast<TCAEventBuilder*>(fBlockSource.get()) != nullptr;
+    if (!fSelection.empty())
+    {
+        if (fEntryIndexFileName.empty())
+        {
+            throw std::runtime_error("[ERROR] Sorting only " + fSelection + " events needs the entry index of run " + fRunFileName);
+        }
+        if (buildsEvents)
+        {
+            throw std::runtime_error("[ERROR] Events built while sorting cannot be selected through entry index " + fEntryIndexFileName);
+        }
+        fEntryIndex = std::make_unique<TCAEntryIndex>(fEntryIndexFileName);
+        if (CAHitCache::GetSourceName(fRunFileName) != fEntryIndex->GetSourceName() || fEntryIndex->GetEntries() != fEntries)
+        {
+            throw std::runtime_error(Form("[ERROR] Entry index %s holds %lld entries of %s, run %s has %lld entries", fEntryIndexFileName.c_str(), fEntryIndex->GetEntries(), fEntryIndex->GetSourceName(), fRunFileName.c_str(), fEntries));
+        }
+        printf("[INFO] Sorting the %lld of %lld entries selected as %s by entry index %s\n", fEntryIndex->CountSelected(fSelectionClasses), fEntries, fSelection.c_str(), fEntryIndexFileName.c_str());
+        return;
+    }
+
+    if (fEntryIndexFileName.empty())
+        return;
+    if (buildsEvents)
+    {
+        printf("[WARN] Entry index %s is not written while building events\n", fEntryIndexFileName.c_str());
+        return;
+    }
+    fEntryIndex = std::make_unique<TCAEntryIndex>(fEntries, fRunFileName);
+    fWriteEntryIndex = true;
+    printf("[INFO] Writing entry index %s during the sort\n", fEntryIndexFileName.c_str());
+}
+
+size_t TCAExperiment::GetReadBlockSize() const
+{
+    if (fBlockSource && fBlockSource->GetNaturalBlockSize() > 0)
+        return fBlockSource->GetNaturalBlockSize();
+    if (fBlockSize > 0)
+        return fBlockSize;
+    return (fBlockSource || fHitCacheWriter || fWriteEntryIndex) ? kDefaultBlockSize : 0; // Listfiles, hit caches and entry indexes are only handled in blocks
+}
+
+std::vector<TCAExperiment::EntryRange> TCAExperiment::MakeEntryRanges() const
+{
+    // Many more ranges than threads, so the work queue has something to steal when a thread lands on slow entries
+    const Long64_t nRanges = std::max<Long64_t>(1, static_cast<Long64_t>(fNThreads * kRangesPerThread));
+    Long64_t rangeSize = std::max(kMinEntriesPerRange, (fEntries + nRanges - 1) / nRanges);
+
+    std::vector<EntryRange> ranges;
+    if (IsSelecting())
+    {
+        // Only spans of selected entries are read, split like the run itself so the work queue still has ranges to steal
+        const auto spans = fEntryIndex->GetSelectedRanges(fSelectionClasses, std::max<Long64_t>(kMinSelectionGap, GetReadBlockSize()));
+        Long64_t nSpanEntries = 0;
+        for (const auto& [first, last] : spans)
+            nSpanEntries += last - first;
+        rangeSize = std::max(kMinEntriesPerRange, (nSpanEntries + nRanges - 1) / nRanges);
+        for (const auto& [first, last] : spans)
+        {
+            for (Long64_t entry = first; entry < last; entry += rangeSize)
+                ranges.emplace_back(entry, std::min(entry + rangeSize, last));
+        }
+        return ranges;
+    }
+    if (!fClusters.empty())
+    {
+        // Neighbouring clusters are merged up to the range size, a cluster is only split when there are fewer clusters than threads
+        const bool splitClusters = fClusters.size() < fNThreads;
+        if (splitClusters)
+            rangeSize = std::max<Long64_t>(1, (fEntries + fNThreads - 1) / fNThreads);
+        for (const auto& [first, last] : fClusters)
+        {
+            if (splitClusters)
+            {
+                for (Long64_t entry = first; entry < last; entry += rangeSize)
+                    ranges.emplace_back(entry, std::min(entry + rangeSize, last));
+            }
+            else if (!ranges.empty() && ranges.back().second - ranges.back().first < rangeSize)
+                ranges.back().second = last;
+            else
+                ranges.emplace_back(first, last);
+        }
+        return ranges;
+    }
+
+    // Whole blocks per range for block sources, so a range never splits a listfile or hit cache block between workers
+    if (const Long64_t blockSize = GetReadBlockSize(); blockSize > 0)
+        rangeSize = (rangeSize + blockSize - 1) / blockSize * blockSize;
+
+    for (Long64_t first = 0; first < fEntries; first += rangeSize)
+    {
+        ranges.emplace_back(first, std::min(first + rangeSize, fEntries));
+    }
+    return ranges;
+}
+
+void TCAExperiment::Sort()
+{
+    if (fRunFileName.empty())
+    {
+        throw std::runtime_error("[ERROR] No run file open, call OpenRun() before Sort()");
+    }
+    ROOT::EnableThreadSafety();
+
+    // Read-ahead needs blocks to hand over, entry-by-entry sorts always read inline
+    const bool prefetch = fNIOThreads > 0 && GetReadBlockSize() > 0;
+    const auto ranges = MakeEntryRanges();
+    TCAWorkQueue workQueue(ranges, prefetch ? fNIOThreads : fNThreads);
+    fActiveColumns = GetActiveColumns();
+    fRejectedHits = 0;
+    fSortError = nullptr;
+    fSortFailed = false;
+    printf("[INFO] Reading %zu of %zu event data branches\n", fActiveColumns.count(), fActiveColumns.size());
+    // One reader slot per thread touching the run tree, set up once and reused by every range and later sorts of the run
+    const size_t nReaderSlots = std::max(fNThreads, fNIOThreads);
+    if (!fBlockSource && (!fEventPool || !fEventPool->IsCompatible(fRunFileName, nReaderSlots, fActiveColumns)))
+        fEventPool = std::make_unique<TCAEventPool>(this, fRunFileName, nReaderSlots, fActiveColumns);
+    std::atomic<uint64_t> processedEntries = 0;
+    uint64_t totalEntries = 0;
+    for (const auto& [first, last] : ranges)
+        totalEntries += last - first;
+
+    if (GetReadBlockSize() > 0)
+        printf("[INFO] Sorting %llu entries in %zu ranges on %u threads, %zu entries per block\n", static_cast<unsigned long long>(totalEntries), ranges.size(), fNThreads, GetReadBlockSize());
+    else
+        printf("[INFO] Sorting %llu entries in %zu ranges on %u threads\n", static_cast<unsigned long long>(totalEntries), ranges.size(), fNThreads);
+    std::thread progressThread;
+    if (fShowProgress)
+        progressThread = std::thread(CAUtilities::DisplayProgressBar, std::ref(processedEntries), totalEntries);
+    if (!fSnapshotFileName.empty() && (fSnapshotInterval > 0.0 || fSnapshotEntries > 0))
+    {
+        printf("[INFO] Writing snapshots to %s\n", fSnapshotFileName.c_str());
+        fSnapshotWriter = std::make_unique<TCASnapshotWriter>(this, fSnapshotFileName, fSnapshotInterval, fSnapshotEntries, fNThreads, processedEntries);
+    }
+    std::vector<std::thread> workers;
+    if (prefetch)
+    {
+        // Each I/O thread owns enough blocks to keep the queue full while every worker holds one of its blocks
+        const size_t nBlocks = (fPrefetchDepth + fNThreads + fNIOThreads - 1) / fNIOThreads + 1;
+        printf("[INFO] Reading ahead on %u I/O threads, up to %zu decoded blocks queued\n", fNIOThreads, fPrefetchDepth);
+        BlockQueue filledBlocks(fPrefetchDepth);
+        std::vector<std::unique_ptr<BlockQueue>> freeBlocks;
+        std::vector<std::thread> prefetchers;
+        for (unsigned int i = 0; i < fNIOThreads; i++)
+        {
+            freeBlocks.push_back(std::make_unique<BlockQueue>(nBlocks));
+            prefetchers.emplace_back(&TCAExperiment::PrefetchWorker, this, i, std::ref(workQueue), std::ref(filledBlocks), std::ref(*freeBlocks.back()), nBlocks);
+        }
+        for (unsigned int i = 0; i < fNThreads; i++)
+            workers.emplace_back(&TCAExperiment::PrefetchedSortWorker, this, i, std::ref(workQueue), std::ref(filledBlocks), std::ref(freeBlocks), std::ref(processedEntries));
+
+        // I/O threads return once their blocks are back, only then can the workers be told no more blocks are coming
+        for (auto& thread : prefetchers)
+            thread.join();
+        filledBlocks.Close();
+    }
+    else
+    {
+        for (unsigned int i = 0; i < fNThreads; i++)
+            workers.emplace_back(&TCAExperiment::SortWorker, this, i, std::ref(workQueue), std::ref(processedEntries));
+    }
+    for (auto& thread : workers)
+        thread.join();
+    fSnapshotWriter.reset();
+
+    processedEntries = totalEntries; // Release the progress bar even if a worker bailed out early
+    if (progressThread.joinable())
+        progressThread.join();
+    if (fSortError)
+    {
+        // Neither a hit cache nor an entry index of a partial sort is kept
+        fHitCacheWriter.reset();
+        fWriteEntryIndex = false;
+        std::rethrow_exception(fSortError);
+    }
+#if DEBUG >= 2
+    printf("[INFO] %zu of %zu ranges were stolen from another thread\n", workQueue.GetStealCount(), ranges.size());
+#endif // DEBUG
+    if (fPileUpPolicy == TCAEventBlock::kRejectPileUp)
+        printf("[INFO] Rejected %llu piled-up channels\n", static_cast<unsigned long long>(fRejectedHits.load()));
+
+    if (fHitCacheWriter)
+    {
+        fHitCacheWriter->Close();
+        fHitCacheWriter.reset();
+    }
+    if (fWriteEntryIndex)
+    {
+        fEntryIndex->Write(fEntryIndexFileName);
+        fWriteEntryIndex = false;
+        printf("[INFO] Wrote entry index %s\n", fEntryIndexFileName.c_str());
+    }
+}
+
+void TCAExperiment::SortWorker(size_t slot, TCAWorkQueue& workQueue, std::atomic<uint64_t>& processedEntries)
+{
+    // Any exception stops the sort, the other workers finish their current range and Sort() rethrows it
+    try
+    {
+        SortRanges(slot, workQueue, processedEntries);
+    }
+    catch (...)
+    {
+        StopSort(workQueue);
+    }
+}
+
+void TCAExperiment::SortRanges(size_t slot, TCAWorkQueue& workQueue, std::atomic<uint64_t>& processedEntries)
+{
+    std::vector<TCAVirtualHistogram::Filler> fillers;
+    std::vector<TCAVirtualHistogram::BlockFiller> blockFillers;
+    const auto fillBuffer = MakeFillers(fillers, blockFillers); // Flushed when the worker returns
+    const auto snapshots = fSnapshotWriter ? fSnapshotWriter->MakeClient(slot, fillBuffer.get()) : nullptr;
+
+    // Listfiles and hit caches are mapped once and decoded by every worker, no per-worker setup beyond the block
+    const size_t blockSize = GetReadBlockSize();
+    if (fBlockSource)
+    {
+        TCAEventBlock block(GetBlockSourceWidths(), blockSize);
+        TCAEvent event(this);
+        event.SetBlock(&block);
+        for (EntryRange range; workQueue.Pop(slot, range);)
+        {
+            const auto [first, last] = range;
+            size_t nEntries = 0;
+            for (Long64_t entry = first; (nEntries = ReadBlock(block, entry, last)) > 0; entry += nEntries)
+            {
+                ProcessBlock(block, event, fillers, blockFillers);
+                processedEntries += nEntries;
+                if (snapshots)
+                    snapshots->Poll();
+            }
+        }
+        return;
+    }
+
+    // Each worker reads through its own pool slot, a copy of the run opened once and kept for all the ranges it takes
+    TTree* tree = fEventPool->GetTree(slot);
+
+    if (blockSize > 0)
+    {
+        TCAEventBlock block(tree, blockSize, fActiveColumns);
+        TCAEvent event(this);
+        event.SetBlock(&block);
+        for (EntryRange range; workQueue.Pop(slot, range);)
+        {
+            const auto [first, last] = range;
+            size_t nEntries = 0;
+            for (Long64_t entry = first; (nEntries = ReadBlock(block, entry, last)) > 0; entry += nEntries)
+            {
+                ProcessBlock(block, event, fillers, blockFillers);
+                processedEntries += nEntries;
+                if (snapshots)
+                    snapshots->Poll();
+            }
+        }
+        return;
+    }
+
+    if (!blockFillers.empty())
+    {
+        std::cerr << "[WARN] " << blockFillers.size() << " histograms are only filled per event block and stay empty with a block size of 0" << std::endl;
+    }
+    if (fBuildHits)
+    {
+        std::cerr << "[WARN] Hit lists are only built for event blocks and stay empty with a block size of 0" << std::endl;
+    }
+    if (fPileUpPolicy != TCAEventBlock::kKeepPileUp)
+    {
+        std::cerr << "[WARN] Pile-up flags are only built for event blocks, piled-up channels are kept with a block size of 0" << std::endl;
+    }
+
+    auto& reader = fEventPool->GetReader(slot);
+    auto& event = fEventPool->GetEvent(slot);
+    for (EntryRange range; workQueue.Pop(slot, range);)
+    {
+        const auto [first, last] = range;
+        if (IsSelecting())
+        {
+            // Gated sorts jump from one selected entry to the next, the entries in between are never loaded
+            for (Long64_t entry = first; entry < last; entry++)
+            {
+                if (!fEntryIndex->Matches(entry, fSelectionClasses))
+                    continue;
+                if (reader.SetEntry(entry) != TTreeReader::kEntryValid)
+                {
+                    throw std::runtime_error(Form("[ERROR] Reading entry %lld failed with status %d", entry, static_cast<int>(reader.GetEntryStatus())));
+                }
+                for (auto& filler : fillers)
+                    filler(&event);
+            }
+            processedEntries += last - first;
+            if (snapshots)
+                snapshots->Poll();
+            continue;
+        }
+        fEventPool->SetRange(slot, first, last);
+
+        uint64_t localEntries = 0;
+        while (reader.Next())
+        {
+            for (auto& filler : fillers)
+                filler(&event);
+            if (++localEntries == kProgressUpdateEntries)
+            {
+                processedEntries += localEntries;
+                localEntries = 0;
+                if (snapshots)
+                    snapshots->Poll();
+            }
+        }
+        processedEntries += localEntries;
+
+        if (reader.GetEntryStatus() != TTreeReader::kEntryBeyondEnd && reader.GetEntryStatus() != TTreeReader::kEntryValid)
+        {
+            throw std::runtime_error(Form("[ERROR] Reading entries %lld-%lld stopped with status %d", first, last, static_cast<int>(reader.GetEntryStatus())));
+        }
+    }
+}
+
+void TCAExperiment::PrefetchWorker(size_t slot, TCAWorkQueue& workQueue, BlockQueue& filledBlocks, BlockQueue& freeBlocks, size_t nBlocks)
+{
+    // Blocks read from a run tree stay bound to this thread's copy of the run, so they always come back here
+    TTree* tree = nullptr;
+    if (!fBlockSource)
+    {
+        try
+        {
+            tree = fEventPool->GetTree(slot);
+        }
+        catch (...)
+        {
+            StopSort(workQueue);
+            return;
+        }
+    }
+
+    std::vector<std::unique_ptr<TCAEventBlock>> blocks;
+    for (size_t i = 0; i < nBlocks; i++)
+    {
+        if (tree != nullptr)
+            blocks.push_back(std::make_unique<TCAEventBlock>(tree, GetReadBlockSize(), fActiveColumns));
+        else
+            blocks.push_back(std::make_unique<TCAEventBlock>(GetBlockSourceWidths(), GetReadBlockSize()));
+        freeBlocks.Push({slot, blocks.back().get(), 0});
+    }
+
+    PrefetchedBlock free{slot, nullptr, 0}; // Block being filled, if any
+    try
+    {
+        for (EntryRange range; workQueue.Pop(slot, range);)
+        {
+            const auto [first, last] = range;
+            for (Long64_t entry = first; entry < last && freeBlocks.Pop(free);)
+            {
+                free.fEntries = ReadBlock(*free.fBlock, entry, last);
+                if (free.fEntries == 0)
+                    break;
+                entry += free.fEntries;
+                filledBlocks.Push(free);
+                free.fBlock = nullptr;
+            }
+            if (free.fBlock != nullptr)
+            {
+                freeBlocks.Push(free);
+                free.fBlock = nullptr;
+            }
+        }
+    }
+    catch (...)
+    {
+        StopSort(workQueue);
+        if (free.fBlock != nullptr)
+            freeBlocks.Push(free);
+    }
+
+    // Wait until the workers hand every block back before the blocks and the run file go away
+    PrefetchedBlock returned;
+    for (size_t nReturned = 0; nReturned < nBlocks && freeBlocks.Pop(returned);)
+        nReturned++;
+}
+
+void TCAExperiment::PrefetchedSortWorker(size_t worker, TCAWorkQueue& workQueue, BlockQueue& filledBlocks, std::vector<std::unique_ptr<BlockQueue>>& freeBlocks, std::atomic<uint64_t>& processedEntries)
+{
+    std::vector<TCAVirtualHistogram::Filler> fillers;
+    std::vector<TCAVirtualHistogram::BlockFiller> blockFillers;
+    std::unique_ptr<TCAFillBuffer> fillBuffer; // Flushed when the worker returns
+    std::unique_ptr<TCASnapshotWriter::Client> snapshots;
+    try
+    {
+        fillBuffer = MakeFillers(fillers, blockFillers);
+        snapshots = fSnapshotWriter ? fSnapshotWriter->MakeClient(worker, fillBuffer.get()) : nullptr;
+    }
+    catch (...)
+    {
+        StopSort(workQueue);
+    }
+
+    // After a failure the blocks are still handed back, the I/O threads wait for all of them before returning
+    TCAEvent event(this);
+    for (PrefetchedBlock prefetched; filledBlocks.Pop(prefetched);)
+    {
+        const auto& block = *prefetched.fBlock;
+        if (!fSortFailed)
+        {
+            try
+            {
+                event.SetBlock(&block);
+                ProcessBlock(block, event, fillers, blockFillers);
+                processedEntries += prefetched.fEntries; // As the inline workers count, entries dropped by a selection included
+            }
+            catch (...)
+            {
+                StopSort(workQueue);
+            }
+            event.SetBlock(nullptr);
+        }
+        freeBlocks[prefetched.fSlot]->Push(prefetched);
+        if (snapshots && !fSortFailed)
+            snapshots->Poll(); // After handing the block back, the I/O thread reads on while this worker copies
+    }
+}
+
+void TCAExperiment::StopSort(TCAWorkQueue& workQueue)
+{
+    std::lock_guard<std::mutex> lock(fSortErrorMutex);
+    if (!fSortError)
+        fSortError = std::current_exception();
+    fSortFailed = true;
+    workQueue.Stop(); // No more ranges are handed out, the threads return once their current range is done
+}
+
+std::unique_ptr<TCAFillBuffer> TCAExperiment::MakeFillers(std::vector<TCAVirtualHistogram::Filler>& fillers, std::vector<TCAVirtualHistogram::BlockFiller>& blockFillers)
+{
+    auto fillBuffer = fFillBufferSize > 0 ? std::make_unique<TCAFillBuffer>(fFillBufferSize) : nullptr;
+    for (auto owner : GetHistogramOwners())
+        owner->AppendFillers(fillers, blockFillers, fillBuffer.get(), GetReadBlockSize() > 0);
+    return fillBuffer;
+}
+
+std::array<size_t, TCAEventBlock::kNColumns> TCAExperiment::GetBlockSourceWidths() const
+{
+    auto widths = fBlockSource->GetColumnWidths();
+    for (size_t column = 0; column < widths.size(); column++)
+    {
+        if (!fActiveColumns.test(column))
+            widths[column] = 0; // Pruned columns are skipped by the decoders
+    }
+    return widths;
+}
+
+size_t TCAExperiment::ReadBlock(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry)
+{
+    const size_t nEntries = DecodeBlock(block, firstEntry, lastEntry);
+    if (nEntries == 0)
+        return 0;
+    // The cache keeps the data as read, later sorts apply their own pile-up policy to it
+    if (fHitCacheWriter)
+        fHitCacheWriter->WriteBlock(block);
+    FinishBlock(block);
+    return nEntries;
+}
+
+size_t TCAExperiment::DecodeBlock(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry)
+{
+    const size_t nEntries = fBlockSource ? fBlockSource->Read(block, firstEntry, lastEntry) : block.Read(firstEntry, lastEntry);
+    if (nEntries == 0)
+        return 0;
+    if (IsSelecting())
+    {
+        // Spans bridge short gaps between selected entries, the unselected entries read with them go here
+        thread_local std::vector<bool> keep;
+        keep.resize(block.GetEntries());
+        for (size_t i = 0; i < keep.size(); i++)
+            keep[i] = fEntryIndex->Matches(block.GetFirstEntry() + i, fSelectionClasses);
+        block.Compact(keep);
+    }
+    return nEntries;
+}
+
+void TCAExperiment::FinishBlock(TCAEventBlock& block)
+{
+    // Early reject: piled-up channels are blanked before hit lists, calibrations and add-back ever see them
+    if (fPileUpPolicy != TCAEventBlock::kKeepPileUp || fWriteEntryIndex)
+        block.BuildFlags();
+    if (fPileUpPolicy == TCAEventBlock::kRejectPileUp)
+        fRejectedHits += block.RejectPileUp();
+    if (fWriteEntryIndex)
+        fEntryIndex->Fill(block);
+    if (fBuildHits)
+        block.BuildHits(fHitThreshold);
+}
+
+void TCAExperiment::ProcessBlock(const TCAEventBlock& block, TCAEvent& event, std::vector<TCAVirtualHistogram::Filler>& fillers, std::vector<TCAVirtualHistogram::BlockFiller>& blockFillers)
+{
+    for (auto& blockFiller : blockFillers)
+        blockFiller(block);
+    if (fillers.empty())
+        return;
+    for (size_t i = 0; i < block.GetEntries(); i++)
+    {
+        event.SetBlockEntry(i);
+        for (auto& filler : fillers)
+            filler(&event);
+    }
+}
+
+TCAOutputWriter::Items TCAExperiment::CollectOutput()
+{
+    MergeHistograms();
+
+    std::vector<std::pair<TCAVirtualHistogram*, std::string>> histograms;
+    for (const auto& [owner, directory] : GetOwnerDirectories())
+    {
+        std::vector<TCAVirtualHistogram*> ownerHistograms;
+        owner->AppendHistograms(ownerHistograms);
+        for (auto histogram : ownerHistograms)
+            histograms.emplace_back(histogram, directory);
+    }
+
+    // Native histograms become dense ROOT histograms here, which for large matrices costs as much as their merge
+    TCAOutputWriter::Items items(histograms.size());
+    CAUtilities::ParallelFor(histograms.size(), fNThreads, [&histograms, &items](size_t i) { items[i] = {histograms[i].second, histograms[i].first->GetOutput()}; });
+    items.erase(std::remove_if(items.begin(), items.end(), [](const TCAOutputWriter::Item& item) { return !item.fObject; }), items.end());
+    return items;
+}
+
+void TCAExperiment::WriteOutput(const std::string& outputFileName)
+{
+    TCAOutputWriter::Write(outputFileName, CollectOutput());
+}
+
+void TCAExperiment::WriteSnapshot(const std::string& fileName)
+{
+    auto snapshotFile = std::unique_ptr<TFile>(TFile::Open(fileName.c_str(), "RECREATE"));
+    if (!snapshotFile || snapshotFile->IsZombie())
+    {
+        throw std::runtime_error("[ERROR] Could not open snapshot file " + fileName);
+    }
+    TCAOutputWriter::DirectoryMap directories;
+    for (const auto& [owner, directory] : GetOwnerDirectories())
+    {
+        TCAOutputWriter::GetDirectory(snapshotFile.get(), directory, directories)->cd();
+        owner->WriteSnapshots();
+    }
+    snapshotFile->Close();
+}
+
+void TCAExperiment::MergeHistograms()
+{
+    // Spectra merge one per thread, side by side. Matrices would leave all but a few threads idle that way, so each of
+    // them merges alone with the threads sharing its tree reduction, largest first
+    std::vector<TCAVirtualHistogram*> small, large;
+    for (auto histogram : GetHistograms())
+        (histogram->GetNcells() >= kLargeMergeCells ? large : small).push_back(histogram);
+    std::sort(large.begin(), large.end(), [](const auto a, const auto b) { return a->GetNcells() > b->GetNcells(); });
+
+    printf("[INFO] Merging %zu histograms and %zu matrices on %u threads\n", small.size(), large.size(), fNThreads);
+    CAUtilities::ParallelFor(small.size(), fNThreads, [&small](size_t i) { small[i]->MergeReplicas(1); });
+    for (auto histogram : large)
+        histogram->MergeReplicas(fNThreads);
+}
+
+void TCAExperiment::Accumulate(TCAExperiment& other)
+{
+    other.MergeHistograms();
+    auto owners = GetHistogramOwners();
+    auto otherOwners = other.GetHistogramOwners();
+    if (owners.size() != otherOwners.size())
+    {
+        throw std::runtime_error(Form("[ERROR] Cannot accumulate experiment %s into %s, their detector trees differ", other.GetName(), GetName()));
+    }
+    for (size_t i = 0; i < owners.size(); i++)
+        owners[i]->AccumulateHistograms(*otherOwners[i]);
+}
+
+void TCAExperiment::PrintInfo() const
+{
+    printf("Experiment %s (%s), %zu modules, %d histograms\n", GetName(), GetTitle(), fModules.size(), fHistograms.GetEntriesFast());
+    for (const auto& module : fModules)
+        module->PrintInfo();
+}
@@ -0,0 +1,65 @@
+// Standard C++ includes
+#include <algorithm>
+
+// ROOT includes
+
+// Project includes
+#include "TCAFillBuffer.hpp"
+
+void TCAFillTarget::SetFillBuffer(TCAFillBuffer* buffer)
+{
+    if (buffer == fFillBuffer)
+        return; // Event and block fillers of one thread share the replica and its buffer
+    if (fFillBuffer != nullptr)
+        fFillBuffer->Flush(); // Fills already buffered still belong to this replica
+    fFillBuffer = buffer;
+    fFillBufferID = buffer != nullptr ? buffer->Register(this) : 0;
+}
+
+TCAFillBuffer::TCAFillBuffer(size_t capacity)
+    : fFills(std::max<size_t>(1, capacity)), fBucketed(std::max<size_t>(1, capacity))
+{
+}
+
+TCAFillBuffer::~TCAFillBuffer()
+{
+    Flush();
+    for (auto target : fTargets)
+    {
+        if (target->GetFillBuffer() == this)
+            target->SetFillBuffer(nullptr);
+    }
+}
+
+uint32_t TCAFillBuffer::Register(TCAFillTarget* target)
+{
+    fTargets.push_back(target);
+    return static_cast<uint32_t>(fTargets.size() - 1);
+}
+
+void TCAFillBuffer::Flush()
+{
+    if (fSize == 0)
+        return;
+
+    // Counting sort by target: one pass to size the buckets, one to scatter the bins into them
+    fOffsets.assign(fTargets.size() + 1, 0);
+    for (size_t i = 0; i < fSize; i++)
+        fOffsets[(fFills[i] >> 32) + 1]++;
+    for (size_t target = 0; target < fTargets.size(); target++)
+        fOffsets[target + 1] += fOffsets[target];
+    for (size_t i = 0; i < fSize; i++)
+        fBucketed[fOffsets[fFills[i] >> 32]++] = static_cast<uint32_t>(fFills[i]);
+
+    // The scatter left each offset at the end of its bucket, which is the start of the next
+    uint32_t first = 0;
+    for (size_t target = 0; target < fTargets.size(); target++)
+    {
+        const uint32_t last = fOffsets[target];
+        if (last > first)
+            fTargets[target]->ApplyFills(fBucketed.data() + first, last - first);
+        first = last;
+    }
+    fSize = 0;
+    fNFlushes++;
+}
@@ -1,6 +1,8 @@
 // Standard C++ includes
+#include <stdexcept>
 
 // ROOT includes
+#include <TString.h>
 
 // Project includes
 #include "TCAHistogramOwner.hpp"
@@ -8,12 +10,79 @@
 TCAHistogramOwner::TCAHistogramOwner(const char* name, const char* title)
     : TNamed(name, title), fOwnerID(fgOwnerIDCounter++), fHistograms()
 {
+    fHistograms.SetOwner(kTRUE);
 }
 
 TCAHistogramOwner::~TCAHistogramOwner()
 {
 }
 
+void TCAHistogramOwner::AppendFillers(std::vector<TCAVirtualHistogram::Filler>& fillers, std::vector<TCAVirtualHistogram::BlockFiller>& blockFillers, TCAFillBuffer* buffer, bool readsBlocks)
+{
+    for (Int_t i = 0; i < fHistograms.GetEntriesFast(); i++)
+    {
+        auto hist = static_cast<TCAVirtualHistogram*>(fHistograms.UncheckedAt(i));
+        if (readsBlocks)
+        {
+            if (auto blockFiller = hist->MakeBlockFiller(buffer))
+                blockFillers.push_back(blockFiller);
+            else if (auto filler = hist->MakeFiller(buffer))
+                fillers.push_back(filler);
+        }
+        else
+        {
+            // Entry by entry a histogram with both kinds is filled per event, one with only a block filler stays empty
+            if (auto filler = hist->MakeFiller(buffer))
+                fillers.push_back(filler);
+            else if (auto blockFiller = hist->MakeBlockFiller(buffer))
+                blockFillers.push_back(blockFiller);
+        }
+    }
+}
+
+void TCAHistogramOwner::AppendDependencies(TCAEvent::ColumnMask& columns) const
+{
+    for (Int_t i = 0; i < fHistograms.GetEntriesFast(); i++)
+    {
+        columns |= static_cast<const TCAVirtualHistogram*>(fHistograms.UncheckedAt(i))->GetDependencies();
+    }
+}
+
+void TCAHistogramOwner::AppendHistograms(std::vector<TCAVirtualHistogram*>& histograms) const
+{
+    for (Int_t i = 0; i < fHistograms.GetEntriesFast(); i++)
+        histograms.push_back(static_cast<TCAVirtualHistogram*>(fHistograms.UncheckedAt(i)));
+}
+
+void TCAHistogramOwner::AccumulateHistograms(TCAHistogramOwner& other)
+{
+    if (other.fHistograms.GetEntriesFast() != fHistograms.GetEntriesFast())
+    {
+        throw std::runtime_error(Form("[ERROR] Cannot accumulate %d histograms of %s into the %d histograms of %s", other.fHistograms.GetEntriesFast(), other.GetName(), fHistograms.GetEntriesFast(), GetName()));
+    }
+    for (Int_t i = 0; i < fHistograms.GetEntriesFast(); i++)
+    {
+        auto hist = static_cast<TCAVirtualHistogram*>(fHistograms.UncheckedAt(i));
+        hist->Accumulate(*static_cast<TCAVirtualHistogram*>(other.fHistograms.UncheckedAt(i)));
+    }
+}
+
+void TCAHistogramOwner::WriteHistograms()
+{
+    for (Int_t i = 0; i < fHistograms.GetEntriesFast(); i++)
+    {
+        fHistograms.UncheckedAt(i)->Write();
+    }
+}
+
+void TCAHistogramOwner::WriteSnapshots()
+{
+    for (Int_t i = 0; i < fHistograms.GetEntriesFast(); i++)
+    {
+        static_cast<TCAVirtualHistogram*>(fHistograms.UncheckedAt(i))->WriteSnapshot();
+    }
+}
+
 // std::vector<std::shared_ptr<TH1>> TCAHistogramOwner::CreateThreadLocalPtrs()
 // {
 //     std::vector<std::shared_ptr<TH1>> ptrs;
@@ -0,0 +1,383 @@
+// Standard C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+// POSIX includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ROOT includes
+#include <RZip.h>
+#include <TString.h>
+
+// Project includes
+#include "TCAHitCache.hpp"
+
+namespace
+{
+    static constexpr size_t kMaxColumnWidth = 64; // Fill masks are stored in 64 bits
+
+    void PutVarint(std::vector<unsigned char>& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    uint64_t GetVarint(const unsigned char*& pos, const unsigned char* end)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; pos < end && shift < 64; shift += 7)
+        {
+            const unsigned char byte = *pos++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        throw std::runtime_error("[ERROR] Corrupt block in hit cache, varint runs past the end of the block");
+    }
+
+    inline uint64_t ZigZag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+    inline int64_t UnZigZag(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+    // Columns are stored one after the other so similar values sit together for the compressor
+    void EncodeBlock(const TCAEventBlock& block, std::vector<unsigned char>& out)
+    {
+        out.clear();
+        PutVarint(out, block.GetEntries());
+        for (size_t column = 0; column < TCAEventBlock::kNColumns; column++)
+        {
+            const double* data = block.GetColumnData(column);
+            if (data == nullptr)
+                continue;
+            const size_t width = block.GetColumnWidth(column);
+            const size_t filterID = column % TCAEvent::kNFilters;
+
+            int64_t previous = 0; // Module timestamps are stored as differences to the previous entry of the block
+            for (size_t entry = 0; entry < block.GetEntries(); entry++)
+            {
+                const double* values = data + entry * width;
+                uint64_t mask = 0;
+                for (size_t idx = 0; idx < width; idx++)
+                {
+                    if (std::isfinite(values[idx]))
+                        mask |= uint64_t(1) << idx;
+                }
+                PutVarint(out, mask);
+
+                if (filterID == TCAEvent::kPileUp)
+                {
+                    uint64_t flags = 0;
+                    for (size_t idx = 0; idx < width; idx++)
+                    {
+                        if ((mask >> idx & 1) && values[idx] != 0)
+                            flags |= uint64_t(1) << idx;
+                    }
+                    PutVarint(out, flags);
+                    continue;
+                }
+
+                for (size_t idx = 0; idx < width; idx++)
+                {
+                    if ((mask >> idx & 1) == 0)
+                        continue;
+                    const auto value = static_cast<int64_t>(std::floor(values[idx]));
+                    if (filterID == TCAEvent::kModuleTime)
+                    {
+                        PutVarint(out, ZigZag(value - previous));
+                        previous = value;
+                    }
+                    else
+                    {
+                        PutVarint(out, ZigZag(value));
+                    }
+                }
+            }
+        }
+    }
+
+    // Decode entries [skip, skip + nRows) of a stored block into rows [firstRow, firstRow + nRows) of the event block.
+    // Columns are stored back to back, so stored columns the block leaves out (pruned branches) are still walked, just not kept.
+    void DecodeBlock(const unsigned char* pos, const unsigned char* end, const uint32_t* widths, TCAEventBlock& block, size_t skip, size_t nRows, size_t firstRow)
+    {
+        const size_t entries = GetVarint(pos, end);
+        for (size_t column = 0; column < TCAEventBlock::kNColumns; column++)
+        {
+            const size_t width = widths[column];
+            if (width == 0)
+                continue;
+            double* data = block.GetMutableColumnData(column);
+            const size_t filterID = column % TCAEvent::kNFilters;
+
+            int64_t previous = 0;
+            for (size_t entry = 0; entry < entries; entry++)
+            {
+                const bool keep = data != nullptr && entry >= skip && entry < skip + nRows;
+                double* values = keep ? data + (firstRow + entry - skip) * width : nullptr;
+                const uint64_t mask = GetVarint(pos, end);
+                if (keep)
+                    std::fill_n(values, width, std::numeric_limits<double>::quiet_NaN());
+
+                if (filterID == TCAEvent::kPileUp)
+                {
+                    const uint64_t flags = GetVarint(pos, end);
+                    for (size_t idx = 0; keep && idx < width; idx++)
+                    {
+                        if (mask >> idx & 1)
+                            values[idx] = (flags >> idx & 1) ? 1.0 : 0.0;
+                    }
+                    continue;
+                }
+
+                for (size_t idx = 0; idx < width; idx++)
+                {
+                    if ((mask >> idx & 1) == 0)
+                        continue;
+                    int64_t value = UnZigZag(GetVarint(pos, end));
+                    if (filterID == TCAEvent::kModuleTime)
+                    {
+                        value += previous;
+                        previous = value;
+                    }
+                    if (keep)
+                        values[idx] = static_cast<double>(value);
+                }
+            }
+        }
+    }
+} // namespace
+
+bool CAHitCache::Compress(std::vector<unsigned char>& raw, std::vector<unsigned char>& out, ROOT::RCompressionSetting::EAlgorithm::EValues algorithm, int level)
+{
+    out.resize(raw.size());
+    size_t inPos = 0, outPos = 0;
+    while (inPos < raw.size())
+    {
+        int srcSize = static_cast<int>(std::min(raw.size() - inPos, CAHitCache::kMaxZipChunk));
+        int tgtSize = static_cast<int>(std::min(out.size() - outPos, CAHitCache::kMaxZipChunk));
+        int irep = 0;
+        R__zipMultipleAlgorithm(level, &srcSize, reinterpret_cast<char*>(raw.data() + inPos), &tgtSize, reinterpret_cast<char*>(out.data() + outPos), &irep, algorithm);
+        if (irep <= 0 || outPos + irep >= raw.size())
+            return false;
+        inPos += srcSize;
+        outPos += irep;
+    }
+    out.resize(outPos);
+    return true;
+}
+
+void CAHitCache::Decompress(const unsigned char* src, size_t srcSize, unsigned char* tgt, size_t tgtSize)
+{
+    size_t inPos = 0, outPos = 0;
+    while (outPos < tgtSize)
+    {
+        int chunkSrcSize = 0, chunkTgtSize = 0, irep = 0;
+        auto chunk = const_cast<unsigned char*>(src + inPos);
+        if (inPos >= srcSize || R__unzip_header(&chunkSrcSize, chunk, &chunkTgtSize) != 0 || outPos + chunkTgtSize > tgtSize)
+        {
+            throw std::runtime_error("[ERROR] Corrupt compressed block");
+        }
+        R__unzip(&chunkSrcSize, chunk, &chunkTgtSize, tgt + outPos, &irep);
+        if (irep != chunkTgtSize)
+        {
+            throw std::runtime_error("[ERROR] Failed to decompress block");
+        }
+        inPos += chunkSrcSize;
+        outPos += chunkTgtSize;
+    }
+}
+
+std::string CAHitCache::GetSourceName(const std::string& runFileName)
+{
+    return std::filesystem::path(runFileName).filename().string();
+}
+
+TCAHitCacheWriter::TCAHitCacheWriter(const std::string& fileName, const std::string& runFileName, ROOT::RCompressionSetting::EAlgorithm::EValues algorithm, int level)
+    : fFileName(fileName), fLevel(level)
+{
+    fFile = fopen(fFileName.c_str(), "wb");
+    if (!fFile)
+    {
+        throw std::runtime_error("[ERROR] Failed to open hit cache for writing: " + fFileName);
+    }
+
+    // The magic is only filled in by Close(), an interrupted sort leaves no cache that looks valid
+    fHeader.fVersion = CAHitCache::kVersion;
+    fHeader.fAlgorithm = algorithm;
+    std::strncpy(fHeader.fSourceName, CAHitCache::GetSourceName(runFileName).c_str(), CAHitCache::kSourceNameLength - 1);
+    fwrite(&fHeader, sizeof(fHeader), 1, fFile);
+    fOffset = sizeof(fHeader);
+}
+
+TCAHitCacheWriter::~TCAHitCacheWriter()
+{
+    if (fFile)
+    {
+        fclose(fFile);
+        std::remove(fFileName.c_str());
+    }
+}
+
+void TCAHitCacheWriter::WriteBlock(const TCAEventBlock& block)
+{
+    if (block.GetEntries() == 0)
+        return;
+
+    // Encoding and compression run outside the lock, only the append is serialised
+    thread_local std::vector<unsigned char> raw, compressed;
+    EncodeBlock(block, raw);
+    const bool isCompressed = CAHitCache::Compress(raw, compressed, static_cast<ROOT::RCompressionSetting::EAlgorithm::EValues>(fHeader.fAlgorithm), fLevel);
+    const auto& stored = isCompressed ? compressed : raw;
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (size_t column = 0; column < TCAEventBlock::kNColumns; column++)
+    {
+        const size_t width = block.GetColumnData(column) != nullptr ? block.GetColumnWidth(column) : 0;
+        if (width > kMaxColumnWidth)
+        {
+            throw std::runtime_error(Form("[ERROR] Column %zu holds %zu values per entry, the hit cache supports at most %zu", column, width, kMaxColumnWidth));
+        }
+        if (fHasLayout && fHeader.fWidths[column] != width)
+        {
+            throw std::runtime_error("[ERROR] Event block layout changed while writing hit cache " + fFileName);
+        }
+        fHeader.fWidths[column] = width;
+    }
+    fHasLayout = true;
+
+    if (fwrite(stored.data(), 1, stored.size(), fFile) != stored.size())
+    {
+        throw std::runtime_error("[ERROR] Failed to write block to hit cache " + fFileName);
+    }
+    fIndex.push_back({fOffset, static_cast<uint64_t>(block.GetFirstEntry()), static_cast<uint32_t>(block.GetEntries()), static_cast<uint32_t>(stored.size()), static_cast<uint32_t>(raw.size()), 0});
+    fOffset += stored.size();
+    fHeader.fEntries += block.GetEntries();
+    fHeader.fBlockSize = std::max<uint32_t>(fHeader.fBlockSize, block.GetEntries());
+}
+
+void TCAHitCacheWriter::Close()
+{
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (!fFile)
+        return;
+
+    std::sort(fIndex.begin(), fIndex.end(), [](const auto& a, const auto& b) { return a.fFirstEntry < b.fFirstEntry; });
+    // Blocks are numbered back to back, built events do not keep the upstream entry numbers their blocks started from
+    uint64_t nextEntry = 0;
+    for (auto& info : fIndex)
+    {
+        info.fFirstEntry = nextEntry;
+        nextEntry += info.fEntries;
+    }
+    fHeader.fNBlocks = fIndex.size();
+    fHeader.fIndexOffset = fOffset;
+    std::memcpy(fHeader.fMagic, CAHitCache::kMagic, sizeof(fHeader.fMagic));
+
+    const bool ok = fwrite(fIndex.data(), sizeof(CAHitCache::BlockInfo), fIndex.size(), fFile) == fIndex.size() && fseek(fFile, 0, SEEK_SET) == 0 && fwrite(&fHeader, sizeof(fHeader), 1, fFile) == 1;
+    fclose(fFile);
+    fFile = nullptr;
+    if (!ok)
+    {
+        std::remove(fFileName.c_str());
+        throw std::runtime_error("[ERROR] Failed to write block index of hit cache " + fFileName);
+    }
+    printf("[INFO] Wrote hit cache %s with %llu entries in %zu blocks, %.1f MB\n", fFileName.c_str(), static_cast<unsigned long long>(fHeader.fEntries), fIndex.size(), fOffset / 1e6);
+}
+
+TCAHitCacheReader::TCAHitCacheReader(const std::string& fileName)
+    : fFileName(fileName)
+{
+    const int fd = open(fFileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("[ERROR] Could not open hit cache " + fFileName);
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(sizeof(fHeader)))
+    {
+        close(fd);
+        throw std::runtime_error("[ERROR] Hit cache " + fFileName + " is too short to hold a header");
+    }
+    fMapSize = fileStat.st_size;
+    void* map = mmap(nullptr, fMapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        throw std::runtime_error("[ERROR] Could not map hit cache " + fFileName);
+    }
+    fData = static_cast<const unsigned char*>(map);
+    std::memcpy(&fHeader, fData, sizeof(fHeader));
+
+    auto fail = [this](const std::string& reason)
+    {
+        munmap(const_cast<unsigned char*>(fData), fMapSize);
+        fData = nullptr;
+        throw std::runtime_error("[ERROR] Hit cache " + fFileName + " " + reason);
+    };
+    if (std::memcmp(fHeader.fMagic, CAHitCache::kMagic, sizeof(fHeader.fMagic)) != 0)
+        fail("is incomplete or not a hit cache");
+    if (fHeader.fVersion != CAHitCache::kVersion)
+        fail(Form("has version %u, expected %u", fHeader.fVersion, CAHitCache::kVersion));
+    if (fHeader.fIndexOffset + fHeader.fNBlocks * sizeof(CAHitCache::BlockInfo) > fMapSize)
+        fail("is truncated");
+
+    fIndex.resize(fHeader.fNBlocks);
+    std::memcpy(fIndex.data(), fData + fHeader.fIndexOffset, fIndex.size() * sizeof(CAHitCache::BlockInfo));
+    uint64_t nextEntry = 0;
+    for (const auto& info : fIndex)
+    {
+        if (info.fFirstEntry != nextEntry || info.fOffset + info.fStoredSize > fHeader.fIndexOffset)
+            fail("has a damaged block index");
+        nextEntry += info.fEntries;
+    }
+    if (nextEntry != fHeader.fEntries)
+        fail("does not cover all of its entries");
+    madvise(map, fMapSize, MADV_SEQUENTIAL);
+}
+
+TCAHitCacheReader::~TCAHitCacheReader()
+{
+    if (fData != nullptr)
+        munmap(const_cast<unsigned char*>(fData), fMapSize);
+}
+
+std::array<size_t, TCAEventBlock::kNColumns> TCAHitCacheReader::GetColumnWidths() const
+{
+    std::array<size_t, TCAEventBlock::kNColumns> widths{};
+    std::copy(std::begin(fHeader.fWidths), std::end(fHeader.fWidths), widths.begin());
+    return widths;
+}
+
+size_t TCAHitCacheReader::Read(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry) const
+{
+    const size_t nEntries = block.SetRange(firstEntry, std::min(lastEntry, GetEntries()));
+
+    // First stored block holding firstEntry, reads spanning several stored blocks continue into the next ones
+    auto info = std::upper_bound(fIndex.begin(), fIndex.end(), static_cast<uint64_t>(firstEntry), [](uint64_t entry, const auto& b) { return entry < b.fFirstEntry; }) - 1;
+    thread_local std::vector<unsigned char> raw;
+    for (size_t filled = 0; filled < nEntries; ++info)
+    {
+        const size_t skip = firstEntry + filled - info->fFirstEntry;
+        const size_t nRows = std::min<size_t>(info->fEntries - skip, nEntries - filled);
+        const unsigned char* stored = fData + info->fOffset;
+        const unsigned char* data = stored;
+        if (info->fStoredSize != info->fRawSize)
+        {
+            raw.resize(info->fRawSize);
+            CAHitCache::Decompress(stored, info->fStoredSize, raw.data(), raw.size());
+            data = raw.data();
+        }
+        DecodeBlock(data, data + info->fRawSize, fHeader.fWidths, block, skip, nRows, filled);
+        filled += nRows;
+    }
+    return nEntries;
+}
@@ -0,0 +1,241 @@
+// Standard C++ includes
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// POSIX includes
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ROOT includes
+#include <TString.h>
+
+// Project includes
+#include "CAConfiguration.hpp"
+#include "TCADAQModule.hpp"
+#include "TCAListfileReader.hpp"
+
+TCAListfileReader::TCAListfileReader(const std::string& fileName, unsigned int eventIndex)
+    : fFileName(fileName), fEventIndex(eventIndex)
+{
+    for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+        fModuleTypes[moduleID] = GetModuleType(moduleID);
+
+    const int fd = open(fFileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::runtime_error("[ERROR] Could not open listfile " + fFileName);
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(kPreambleWords * sizeof(uint32_t)))
+    {
+        close(fd);
+        throw std::runtime_error("[ERROR] Listfile " + fFileName + " is too short to hold a listfile preamble");
+    }
+
+    fMapSize = fileStat.st_size;
+    void* map = mmap(nullptr, fMapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file referenced
+    if (map == MAP_FAILED)
+    {
+        throw std::runtime_error("[ERROR] Could not map listfile " + fFileName);
+    }
+    madvise(map, fMapSize, MADV_SEQUENTIAL);
+    fWords = static_cast<const uint32_t*>(map);
+    fNWords = fMapSize / sizeof(uint32_t);
+
+    try
+    {
+        BuildIndex();
+    }
+    catch (...)
+    {
+        munmap(const_cast<uint32_t*>(fWords), fMapSize);
+        throw;
+    }
+}
+
+TCAListfileReader::~TCAListfileReader()
+{
+    if (fWords != nullptr)
+        munmap(const_cast<uint32_t*>(fWords), fMapSize);
+}
+
+bool TCAListfileReader::IsListfile(const std::string& fileName)
+{
+    const std::string extension = LISTFILE_EXTENSION;
+    return fileName.size() >= extension.size() && fileName.compare(fileName.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+bool TCAListfileReader::IsQDC(size_t moduleID)
+{
+    return std::strcmp(kModuleTypes[moduleID], "MDPP16QDC") == 0;
+}
+
+uint32_t TCAListfileReader::GetModuleType(size_t moduleID)
+{
+    if (std::strcmp(kModuleTypes[moduleID], "MDPP16SCP") == 0)
+        return kMDPP16SCPType;
+    if (std::strcmp(kModuleTypes[moduleID], "MDPP16QDC") == 0)
+        return kMDPP16QDCType;
+    throw std::runtime_error(Form("[ERROR] Module %s has type %s, listfiles can only be read for MDPP16SCP and MDPP16QDC modules", kModuleNames[moduleID], kModuleTypes[moduleID]));
+}
+
+std::array<size_t, TCAEventBlock::kNColumns> TCAListfileReader::GetColumnWidths() const
+{
+    constexpr size_t kChannels = TCADAQModule::kMDPP16Channels;
+    std::array<size_t, TCAEventBlock::kNColumns> widths{};
+    for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+    {
+        auto width = widths.begin() + moduleID * TCAEvent::kNFilters;
+        width[TCAEvent::kAmplitude] = IsQDC(moduleID) ? 0 : kChannels;
+        width[TCAEvent::kChannelTime] = kChannels;
+        width[TCAEvent::kPileUp] = kChannels;
+        width[TCAEvent::kModuleTime] = 1;
+        width[TCAEvent::kTriggerTime] = 2;
+        width[TCAEvent::kIntLong] = IsQDC(moduleID) ? kChannels : 0;
+        width[TCAEvent::kIntShort] = IsQDC(moduleID) ? kChannels : 0;
+    }
+    return widths;
+}
+
+void TCAListfileReader::BuildIndex()
+{
+    if (std::memcmp(fWords, "MVME", 4) != 0)
+    {
+        throw std::runtime_error("[ERROR] " + fFileName + " has no MVME preamble, only listfile format version 1 is supported");
+    }
+    if (fWords[1] != kVersion)
+    {
+        throw std::runtime_error(Form("[ERROR] %s uses listfile format version %u, only version %u is supported", fFileName.c_str(), fWords[1], kVersion));
+    }
+
+    // Only section headers are touched here, so indexing a run costs a small fraction of decoding it
+    for (size_t offset = kPreambleWords; offset < fNWords;)
+    {
+        const uint32_t header = fWords[offset];
+        const uint32_t type = (header & kSectionTypeMask) >> kSectionTypeShift;
+        const size_t size = header & kSectionSizeMask;
+        if (type == kEndOfFileSection)
+            break;
+        if (offset + 1 + size > fNWords)
+        {
+            fprintf(stderr, "[WARN] Listfile %s ends inside a section, ignoring the last %zu words\n", fFileName.c_str(), fNWords - offset);
+            break;
+        }
+        if (type == kEventSection && ((header & kEventIndexMask) >> kEventIndexShift) == fEventIndex)
+            fEventOffsets.push_back(offset);
+        offset += 1 + size;
+    }
+    printf("[INFO] Indexed %zu events in listfile %s\n", fEventOffsets.size(), fFileName.c_str());
+}
+
+size_t TCAListfileReader::Read(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry) const
+{
+    const size_t nEntries = block.SetRange(firstEntry, std::min(lastEntry, GetEntries()));
+    for (size_t row = 0; row < nEntries; row++)
+        DecodeEvent(fEventOffsets[firstEntry + row], block, row);
+    return nEntries;
+}
+
+void TCAListfileReader::DecodeEvent(size_t offset, TCAEventBlock& block, size_t row) const
+{
+    // Channels without a hit read as NaN, as in MVME's ROOT export
+    for (size_t column = 0; column < TCAEventBlock::kNColumns; column++)
+    {
+        if (auto data = block.GetMutableColumnData(column))
+        {
+            const size_t width = block.GetColumnWidth(column);
+            std::fill_n(data + row * width, width, std::numeric_limits<double>::quiet_NaN());
+        }
+    }
+
+    // Modules are read out in the order of the configuration, a type mismatch means the listfile was taken with another setup
+    const size_t end = offset + 1 + (fWords[offset] & kSectionSizeMask);
+    size_t moduleID = 0;
+    for (size_t pos = offset + 1; pos < end; moduleID++)
+    {
+        const uint32_t moduleHeader = fWords[pos];
+        if (moduleHeader == kEndMarker)
+            break; // End of the event section
+        const size_t size = std::min<size_t>(moduleHeader & kModuleSizeMask, end - pos - 1);
+        if (moduleID < TCAEvent::kNModules)
+        {
+            const uint32_t moduleType = (moduleHeader & kModuleTypeMask) >> kModuleTypeShift;
+            if (moduleType != fModuleTypes[moduleID])
+            {
+                throw std::runtime_error(Form("[ERROR] Readout %zu of the event at word %zu of %s has module type %u, module %s (%s) has type %u", moduleID, offset, fFileName.c_str(), moduleType, kModuleNames[moduleID], kModuleTypes[moduleID], fModuleTypes[moduleID]));
+            }
+            DecodeModule(moduleID, fWords + pos + 1, size, block, row);
+        }
+        pos += 1 + size;
+    }
+}
+
+void TCAListfileReader::DecodeModule(size_t moduleID, const uint32_t* words, size_t nWords, TCAEventBlock& block, size_t row) const
+{
+    auto rowData = [&](TCAEvent::FilterID filterID) -> double*
+    {
+        const size_t column = moduleID * TCAEvent::kNFilters + filterID;
+        auto data = block.GetMutableColumnData(column);
+        return data != nullptr ? data + row * block.GetColumnWidth(column) : nullptr;
+    };
+    double* amplitude = rowData(TCAEvent::kAmplitude);
+    double* channelTime = rowData(TCAEvent::kChannelTime);
+    double* pileUp = rowData(TCAEvent::kPileUp);
+    double* triggerTime = rowData(TCAEvent::kTriggerTime);
+    double* intLong = rowData(TCAEvent::kIntLong);
+    double* intShort = rowData(TCAEvent::kIntShort);
+    const bool isQDC = IsQDC(moduleID);
+
+    uint64_t timestampHigh = 0;
+    for (size_t i = 0; i < nWords; i++)
+    {
+        const uint32_t word = words[i];
+        if (word == kEndMarker || (word & kHeaderMask) == kHeaderWord)
+            continue;
+
+        if ((word & kHeaderMask) == kEndOfEventWord)
+        {
+            if (auto moduleTime = rowData(TCAEvent::kModuleTime))
+                moduleTime[0] = static_cast<double>((timestampHigh << 30) | (word & kTimestampMask));
+            continue;
+        }
+        if ((word & kDataMask) == kExtendedTimestampWord)
+        {
+            timestampHigh = word & kValueMask;
+            continue;
+        }
+        if ((word & kDataMask) != kDataWord)
+            continue; // Fill words
+
+        const uint32_t address = (word >> kAddressShift) & kAddressMask;
+        const double value = word & kValueMask;
+        const size_t channel = address & 0xf;
+        if (address < 16)
+        {
+            // Amplitude (SCP) or long integral (QDC), both carry the pile-up flag of the hit
+            if (double* dest = isQDC ? intLong : amplitude)
+                dest[channel] = value;
+            if (pileUp != nullptr)
+                pileUp[channel] = (word & kPileUpBit) ? 1.0 : 0.0;
+        }
+        else if (address < 32)
+        {
+            if (channelTime != nullptr)
+                channelTime[channel] = value;
+        }
+        else if (address < 34)
+        {
+            if (triggerTime != nullptr)
+                triggerTime[address - 32] = value;
+        }
+        else if (address >= 48 && isQDC && intShort != nullptr)
+        {
+            intShort[channel] = value;
+        }
+    }
+}
@@ -0,0 +1,112 @@
+// Standard C++ includes
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+// ROOT includes
+#include <TDirectory.h>
+#include <TFile.h>
+#include <TString.h>
+
+// Project includes
+#include "TCAOutputWriter.hpp"
+
+TCAOutputWriter::TCAOutputWriter(unsigned int nThreads)
+    : fQueue(std::max(1U, nThreads) * kMaxPendingPerThread)
+{
+    for (unsigned int i = 0; i < std::max(1U, nThreads); i++)
+        fThreads.emplace_back(&TCAOutputWriter::Run, this);
+}
+
+TCAOutputWriter::~TCAOutputWriter()
+{
+    fQueue.Close(); // The threads drain the queue before leaving
+    for (auto& thread : fThreads)
+        thread.join();
+}
+
+void TCAOutputWriter::Submit(const std::string& fileName, Items items)
+{
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fPending++;
+    }
+    if (!fQueue.Push({fileName, std::move(items)}))
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fPending--;
+        throw std::runtime_error("[ERROR] Output writer is shut down, " + fileName + " was not written");
+    }
+}
+
+size_t TCAOutputWriter::Wait()
+{
+    std::unique_lock<std::mutex> lock(fMutex);
+    fWrittenCondition.wait(lock, [this] { return fPending == 0; });
+    const size_t failed = fFailed;
+    fFailed = 0;
+    return failed;
+}
+
+void TCAOutputWriter::Run()
+{
+    for (Output output; fQueue.Pop(output);)
+    {
+        bool failed = false;
+        try
+        {
+            Write(output.first, output.second);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            failed = true;
+        }
+        output.second.clear(); // Release the objects before the next output is taken
+
+        std::lock_guard<std::mutex> lock(fMutex);
+        fPending--;
+        fFailed += failed;
+        fWrittenCondition.notify_all();
+    }
+}
+
+void TCAOutputWriter::Write(const std::string& fileName, const Items& items)
+{
+    auto outputFile = std::unique_ptr<TFile>(TFile::Open(fileName.c_str(), "RECREATE"));
+    if (!outputFile || outputFile->IsZombie())
+    {
+        throw std::runtime_error("[ERROR] Could not open output file " + fileName);
+    }
+
+    printf("[INFO] Writing %zu histograms to %s\n", items.size(), fileName.c_str());
+    DirectoryMap directories;
+    for (const auto& item : items)
+    {
+        if (GetDirectory(outputFile.get(), item.fDirectory, directories)->WriteTObject(item.fObject.get()) <= 0)
+        {
+            throw std::runtime_error(Form("[ERROR] Could not write %s to %s", item.fObject->GetName(), fileName.c_str()));
+        }
+    }
+    outputFile->Close();
+}
+
+TDirectory* TCAOutputWriter::GetDirectory(TDirectory* top, const std::string& path, DirectoryMap& directories)
+{
+    if (path.empty())
+        return top;
+    if (auto known = directories.find(path); known != directories.end())
+        return known->second;
+
+    // Parents first, one level at a time
+    const size_t slash = path.rfind('/');
+    TDirectory* parent = slash == std::string::npos ? top : GetDirectory(top, path.substr(0, slash), directories);
+    TDirectory* directory = parent->mkdir(path.substr(slash == std::string::npos ? 0 : slash + 1).c_str());
+    if (directory == nullptr)
+    {
+        throw std::runtime_error("[ERROR] Could not make directory " + path + " in " + top->GetName());
+    }
+    directories[path] = directory;
+    return directory;
+}
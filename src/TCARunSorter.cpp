@@ -0,0 +1,139 @@
+// Standard C++ includes
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+// ROOT includes
+#include <TROOT.h>
+
+// Project includes
+#include "CAUtilities.hpp"
+#include "TCARunSorter.hpp"
+
+TCARunSorter::TCARunSorter(const std::vector<int>& runNumbers, const ExperimentFactory& factory)
+    : fRunNumbers(runNumbers), fFactory(factory)
+{
+}
+
+size_t TCARunSorter::Sort()
+{
+    if (fRunNumbers.empty())
+        return 0;
+    ROOT::EnableThreadSafety();
+
+    fOpened.clear();
+    fOpenerDone = false;
+    fFailedRuns = 0;
+    if (fSumRuns)
+        fSum = fFactory(fRunNumbers.front()); // Never opened or sorted, only collects the other runs
+
+    const auto nSlots = static_cast<unsigned int>(std::min<size_t>(fConcurrentRuns, fRunNumbers.size()));
+    fRunThreads = std::max(1U, kMaxThreads / nSlots);
+    printf("[INFO] Sorting %zu runs, %u at a time with %u threads each\n", fRunNumbers.size(), nSlots, fRunThreads);
+
+    fOutputWriter = std::make_unique<TCAOutputWriter>(nSlots);
+    std::thread opener(&TCARunSorter::OpenRuns, this);
+    std::vector<std::thread> slots;
+    for (unsigned int i = 0; i < nSlots; i++)
+        slots.emplace_back(&TCARunSorter::SortRuns, this);
+    for (auto& slot : slots)
+        slot.join();
+    opener.join();
+    fFailedRuns += fOutputWriter->Wait();
+    fOutputWriter.reset();
+
+    if (fSum)
+    {
+        try
+        {
+            fSum->WriteOutput(fOutputFileName);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            fFailedRuns = fRunNumbers.size();
+        }
+        fSum.reset();
+    }
+    printf("[INFO] Sorted %zu of %zu runs\n", fRunNumbers.size() - fFailedRuns, fRunNumbers.size());
+    return fFailedRuns;
+}
+
+void TCARunSorter::OpenRuns()
+{
+    for (const int runNumber : fRunNumbers)
+    {
+        // Building the histograms and reading the run header overlap with the runs being sorted
+        OpenedRun run;
+        run.fRunNumber = runNumber;
+        try
+        {
+            run.fExperiment = fFactory(runNumber);
+            run.fExperiment->SetNThreads(fRunThreads);
+            run.fExperiment->SetShowProgress(false);
+            run.fExperiment->OpenRun(CAUtilities::GetRunFileName(fRunFileName, runNumber));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            std::cerr << "[ERROR] Skipping run " << runNumber << std::endl;
+            run.fExperiment.reset();
+        }
+
+        std::unique_lock<std::mutex> lock(fMutex);
+        fTakenCondition.wait(lock, [this] { return fOpened.size() < kOpenAhead; });
+        fOpened.push_back(std::move(run));
+        fOpenedCondition.notify_one();
+    }
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    fOpenerDone = true;
+    fOpenedCondition.notify_all();
+}
+
+bool TCARunSorter::NextRun(OpenedRun& run)
+{
+    std::unique_lock<std::mutex> lock(fMutex);
+    fOpenedCondition.wait(lock, [this] { return !fOpened.empty() || fOpenerDone; });
+    if (fOpened.empty())
+        return false;
+    run = std::move(fOpened.front());
+    fOpened.pop_front();
+    fTakenCondition.notify_one();
+    return true;
+}
+
+void TCARunSorter::SortRuns()
+{
+    for (OpenedRun run; NextRun(run);)
+    {
+        try
+        {
+            if (!run.fExperiment)
+            {
+                throw std::runtime_error(Form("[ERROR] Run %d could not be opened", run.fRunNumber));
+            }
+            run.fExperiment->Sort();
+            if (fSum)
+            {
+                std::lock_guard<std::mutex> lock(fSumMutex);
+                fSum->Accumulate(*run.fExperiment);
+            }
+            else
+            {
+                // The output keeps the merged histograms, the run's replicas are released before the next run
+                fOutputWriter->Submit(CAUtilities::GetRunFileName(fOutputFileName, run.fRunNumber), run.fExperiment->CollectOutput());
+            }
+            printf("[INFO] Finished sorting run %d\n", run.fRunNumber);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            std::lock_guard<std::mutex> lock(fSumMutex);
+            fFailedRuns++;
+        }
+        run.fExperiment.reset(); // Release the run's histograms before waiting for the next one
+    }
+}
@@ -0,0 +1,132 @@
+// Standard C++ includes
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+// ROOT includes
+
+// Project includes
+#include "TCAExperiment.hpp"
+#include "TCAFillBuffer.hpp"
+#include "TCASnapshotWriter.hpp"
+
+TCASnapshotWriter::Client::Client(TCASnapshotWriter& writer, size_t worker, TCAFillBuffer* fillBuffer)
+    : fWriter(writer), fWorker(worker), fFillBuffer(fillBuffer)
+{
+    for (auto histogram : fWriter.fHistograms)
+        fPublishers.push_back(histogram->MakePublisher());
+}
+
+TCASnapshotWriter::Client::~Client()
+{
+    // The replicas are final for this sort, later snapshots use these copies
+    Publish();
+    fWriter.fPublished[fWorker].store(std::numeric_limits<uint64_t>::max(), std::memory_order_release);
+}
+
+void TCASnapshotWriter::Client::Publish()
+{
+    fEpoch = fWriter.fRequested.load(std::memory_order_acquire);
+    if (fFillBuffer != nullptr)
+        fFillBuffer->Flush();
+    for (auto& publisher : fPublishers)
+        publisher();
+    fWriter.fPublished[fWorker].store(fEpoch, std::memory_order_release);
+}
+
+TCASnapshotWriter::TCASnapshotWriter(TCAExperiment* experiment, const std::string& fileName, double interval, uint64_t entryInterval, size_t nWorkers, const std::atomic<uint64_t>& processedEntries)
+    : fExperiment(experiment), fHistograms(experiment->GetHistograms()), fFileName(fileName), fInterval(interval), fEntryInterval(entryInterval),
+      fProcessedEntries(processedEntries), fPublished(nWorkers)
+{
+    // Workers that never start a client, e.g. after failing to open the run, must not hold up the snapshots
+    for (auto& published : fPublished)
+        published = std::numeric_limits<uint64_t>::max();
+    for (auto histogram : fHistograms)
+        histogram->ClearSnapshots();
+    fThread = std::thread(&TCASnapshotWriter::Run, this);
+}
+
+TCASnapshotWriter::~TCASnapshotWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(fMutex);
+        fStop = true;
+    }
+    fStopCondition.notify_all();
+    if (fThread.joinable())
+        fThread.join();
+}
+
+std::unique_ptr<TCASnapshotWriter::Client> TCASnapshotWriter::MakeClient(size_t worker, TCAFillBuffer* fillBuffer)
+{
+    if (worker >= fPublished.size())
+    {
+        throw std::runtime_error("[ERROR] Snapshot client for worker " + std::to_string(worker) + " of " + std::to_string(fPublished.size()));
+    }
+    fPublished[worker].store(0, std::memory_order_release);
+    return std::make_unique<Client>(*this, worker, fillBuffer);
+}
+
+bool TCASnapshotWriter::IsPublished(uint64_t epoch) const
+{
+    for (const auto& published : fPublished)
+    {
+        if (published.load(std::memory_order_acquire) < epoch)
+            return false;
+    }
+    return true;
+}
+
+void TCASnapshotWriter::Run()
+{
+    auto lastTime = std::chrono::steady_clock::now();
+    uint64_t lastEntries = 0;
+    std::unique_lock<std::mutex> lock(fMutex);
+    while (!fStopCondition.wait_for(lock, kPollInterval, [this] { return fStop; }))
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const uint64_t entries = fProcessedEntries.load(std::memory_order_relaxed);
+        const bool timeDue = fInterval.count() > 0 && now - lastTime >= fInterval;
+        const bool entriesDue = fEntryInterval > 0 && entries - lastEntries >= fEntryInterval;
+        if (!timeDue && !entriesDue)
+            continue;
+
+        // Workers see the new epoch after their current block, the writer only polls and never holds them up
+        const uint64_t epoch = fRequested.fetch_add(1, std::memory_order_acq_rel) + 1;
+        while (!IsPublished(epoch))
+        {
+            if (fStopCondition.wait_for(lock, kPollInterval, [this] { return fStop; }))
+                return;
+        }
+
+        lock.unlock();
+        try
+        {
+            Write();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            std::cerr << "[WARN] Snapshot " << epoch << " was not written, the sort goes on" << std::endl;
+        }
+        lock.lock();
+        lastTime = now;
+        lastEntries = entries;
+    }
+}
+
+void TCASnapshotWriter::Write()
+{
+    // Replace the snapshot in one step, a viewer polling the file never opens a half-written one
+    const std::string tempFileName = fFileName + ".tmp";
+    fExperiment->WriteSnapshot(tempFileName);
+    if (std::rename(tempFileName.c_str(), fFileName.c_str()) != 0)
+    {
+        throw std::runtime_error("[ERROR] Could not move snapshot " + tempFileName + " to " + fFileName);
+    }
+    fNSnapshots++;
+#if DEBUG >= 2
+    printf("[INFO] Wrote snapshot %zu to %s\n", fNSnapshots.load(), fFileName.c_str());
+#endif // DEBUG
+}
@@ -0,0 +1,125 @@
+// Standard C++ includes
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+// ROOT includes
+#include <TString.h>
+
+// Project includes
+#include "TCAHitCache.hpp"
+#include "TCASymmetricHistogram.hpp"
+
+namespace
+{
+    static constexpr int kCubeLevel = 5; // Compression level of cube bricks
+} // namespace
+
+void CASymmetricHistogram::WriteM4b(const std::string& fileName, const std::function<void(size_t row, std::vector<uint32_t>& counts)>& getRow)
+{
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("[ERROR] Could not create matrix " + fileName);
+    }
+    std::vector<uint32_t> rows(kM4bRowsPerWrite * kM4bChannels);
+    std::vector<uint32_t> row(kM4bChannels);
+    bool written = true;
+    for (size_t first = 0; first < kM4bChannels && written; first += kM4bRowsPerWrite)
+    {
+        for (size_t i = 0; i < kM4bRowsPerWrite; i++)
+        {
+            getRow(first + i, row);
+            std::copy(row.begin(), row.end(), rows.begin() + i * kM4bChannels);
+        }
+        written = fwrite(rows.data(), sizeof(uint32_t), rows.size(), file) == rows.size();
+    }
+    written = fclose(file) == 0 && written;
+    if (!written)
+    {
+        std::remove(fileName.c_str());
+        throw std::runtime_error("[ERROR] Could not write matrix " + fileName);
+    }
+}
+
+FILE* CASymmetricHistogram::CreateCube(const std::string& fileName, const CubeHeader& header)
+{
+    FILE* file = fopen(fileName.c_str(), "wb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("[ERROR] Could not create cube " + fileName);
+    }
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        fclose(file);
+        std::remove(fileName.c_str());
+        throw std::runtime_error("[ERROR] Could not write cube " + fileName);
+    }
+    return file;
+}
+
+void CASymmetricHistogram::WriteBrick(FILE* file, uint64_t brick, std::vector<uint32_t>& cells, uint32_t algorithm)
+{
+    // Mostly empty bricks compress to a few bytes, the odd brick that does not is stored as is
+    thread_local std::vector<unsigned char> raw, compressed;
+    raw.resize(cells.size() * sizeof(uint32_t));
+    std::memcpy(raw.data(), cells.data(), raw.size());
+    const bool isCompressed = CAHitCache::Compress(raw, compressed, static_cast<ROOT::RCompressionSetting::EAlgorithm::EValues>(algorithm), kCubeLevel);
+    const auto& stored = isCompressed ? compressed : raw;
+
+    BrickHeader header = {brick, static_cast<uint32_t>(stored.size()), static_cast<uint32_t>(raw.size())};
+    if (fwrite(&header, sizeof(header), 1, file) != 1 || fwrite(stored.data(), 1, stored.size(), file) != stored.size())
+    {
+        throw std::runtime_error(Form("[ERROR] Could not write brick %llu of a cube", static_cast<unsigned long long>(brick)));
+    }
+}
+
+void CASymmetricHistogram::CloseCube(FILE* file, const std::string& fileName)
+{
+    if (fclose(file) != 0)
+    {
+        std::remove(fileName.c_str());
+        throw std::runtime_error("[ERROR] Could not write cube " + fileName);
+    }
+}
+
+FILE* CASymmetricHistogram::OpenCube(const std::string& fileName, CubeHeader& header)
+{
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (file == nullptr)
+    {
+        throw std::runtime_error("[ERROR] Could not open cube " + fileName);
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.fMagic, kCubeMagic, sizeof(header.fMagic)) != 0)
+    {
+        fclose(file);
+        throw std::runtime_error("[ERROR] " + fileName + " is truncated or not a cube");
+    }
+    if (header.fVersion != kCubeVersion)
+    {
+        fclose(file);
+        throw std::runtime_error(Form("[ERROR] Cube %s has version %u, expected %u", fileName.c_str(), header.fVersion, kCubeVersion));
+    }
+    return file;
+}
+
+void CASymmetricHistogram::ReadBrick(FILE* file, uint64_t& brick, std::vector<uint32_t>& cells)
+{
+    BrickHeader header;
+    thread_local std::vector<unsigned char> stored;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.fRawSize != cells.size() * sizeof(uint32_t))
+    {
+        throw std::runtime_error("[ERROR] Cube brick is truncated or of the wrong size");
+    }
+    stored.resize(header.fStoredSize);
+    if (fread(stored.data(), 1, stored.size(), file) != stored.size())
+    {
+        throw std::runtime_error("[ERROR] Cube brick is truncated");
+    }
+    if (header.fStoredSize == header.fRawSize)
+        std::memcpy(cells.data(), stored.data(), header.fRawSize);
+    else
+        CAHitCache::Decompress(stored.data(), stored.size(), reinterpret_cast<unsigned char*>(cells.data()), header.fRawSize);
+    brick = header.fBrick;
+}
@@ -0,0 +1,60 @@
+// Standard C++ includes
+#include <algorithm>
+
+// ROOT includes
+
+// Project includes
+#include "TCAWorkQueue.hpp"
+
+TCAWorkQueue::TCAWorkQueue(const std::vector<WorkUnit>& units, size_t nSlots)
+{
+    nSlots = std::max<size_t>(1, nSlots);
+    for (size_t slot = 0; slot < nSlots; slot++)
+    {
+        fDeques.push_back(std::make_unique<SlotDeque>());
+        const size_t first = units.size() * slot / nSlots;
+        const size_t last = units.size() * (slot + 1) / nSlots;
+        fDeques.back()->fUnits.assign(units.begin() + first, units.begin() + last);
+    }
+}
+
+bool TCAWorkQueue::Pop(size_t slot, WorkUnit& unit)
+{
+    auto& own = *fDeques[slot % fDeques.size()];
+    {
+        std::lock_guard<std::mutex> lock(own.fMutex);
+        if (!own.fUnits.empty())
+        {
+            unit = own.fUnits.front();
+            own.fUnits.pop_front();
+            return true;
+        }
+    }
+    return Steal(slot, unit);
+}
+
+void TCAWorkQueue::Stop()
+{
+    for (auto& deque : fDeques)
+    {
+        std::lock_guard<std::mutex> lock(deque->fMutex);
+        deque->fUnits.clear();
+    }
+}
+
+bool TCAWorkQueue::Steal(size_t slot, WorkUnit& unit)
+{
+    // Units are never added after construction, so one pass finding every deque empty means the work is done
+    for (size_t offset = 1; offset < fDeques.size(); offset++)
+    {
+        auto& victim = *fDeques[(slot + offset) % fDeques.size()];
+        std::lock_guard<std::mutex> lock(victim.fMutex);
+        if (victim.fUnits.empty())
+            continue;
+        unit = victim.fUnits.back();
+        victim.fUnits.pop_back();
+        fSteals++;
+        return true;
+    }
+    return false;
+}
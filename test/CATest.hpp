@@ -0,0 +1,40 @@
+#ifndef CATEST_HPP
+#define CATEST_HPP
+
+// C++ Includes
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// ROOT Includes
+
+// Project Includes
+
+// Checks shared by the test programs in test/, each built and run by make test. A failed check is reported and counted,
+// the program then exits non-zero
+namespace CATest
+{
+    inline size_t gFailures = 0;
+
+    inline void Check(bool condition, const std::string& what)
+    {
+        if (condition)
+            return;
+        fprintf(stderr, "[FAIL] %s\n", what.c_str());
+        gFailures++;
+    }
+
+    inline int Result(const char* testName)
+    {
+        if (gFailures > 0)
+        {
+            fprintf(stderr, "[FAIL] %s: %zu checks failed\n", testName, gFailures);
+            return EXIT_FAILURE;
+        }
+        printf("[PASS] %s\n", testName);
+        return EXIT_SUCCESS;
+    }
+
+} // namespace CATest
+
+#endif // CATEST_HPP
@@ -0,0 +1,137 @@
+// Standard C++ includes
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "CATest.hpp"
+#include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+#include "TCAEventBuilder.hpp"
+
+namespace
+{
+    constexpr size_t kNTestModules = 4;
+    constexpr double kWindow = 20.0;
+
+    // Free-running modules, one readout per upstream entry: the module timestamp, and the upstream entry number as the
+    // amplitude of channel 0 so every readout can be traced into the built events
+    class TestSource : public TCAVirtualBlockSource
+    {
+    public:
+        explicit TestSource(std::vector<std::pair<size_t, double>> readouts) : fReadouts(std::move(readouts)) {}
+
+        Long64_t GetEntries() const override { return fReadouts.size(); }
+        std::array<size_t, TCAEventBlock::kNColumns> GetColumnWidths() const override
+        {
+            std::array<size_t, TCAEventBlock::kNColumns> widths = {};
+            for (size_t moduleID = 0; moduleID < kNTestModules; moduleID++)
+            {
+                widths[TCAEvent::GetColumn(moduleID, TCAEvent::kAmplitude)] = 2;
+                widths[TCAEvent::GetColumn(moduleID, TCAEvent::kModuleTime)] = 1;
+            }
+            return widths;
+        }
+        size_t Read(TCAEventBlock& block, Long64_t firstEntry, Long64_t lastEntry) const override
+        {
+            const size_t nEntries = block.SetRange(firstEntry, std::min<Long64_t>(lastEntry, GetEntries()));
+            for (size_t moduleID = 0; moduleID < kNTestModules; moduleID++)
+            {
+                std::fill_n(block.GetMutableColumnData(TCAEvent::GetColumn(moduleID, TCAEvent::kAmplitude)), 2 * nEntries, NAN);
+                std::fill_n(block.GetMutableColumnData(TCAEvent::GetColumn(moduleID, TCAEvent::kModuleTime)), nEntries, NAN);
+            }
+            for (size_t i = 0; i < nEntries; i++)
+            {
+                const auto [moduleID, time] = fReadouts[firstEntry + i];
+                block.GetMutableColumnData(TCAEvent::GetColumn(moduleID, TCAEvent::kAmplitude))[2 * i] = firstEntry + i;
+                block.GetMutableColumnData(TCAEvent::GetColumn(moduleID, TCAEvent::kModuleTime))[i] = time;
+            }
+            return nEntries;
+        }
+
+    private:
+        std::vector<std::pair<size_t, double>> fReadouts; // Module and timestamp per upstream entry
+    };
+
+    // Upstream entries in roughly time order, each module's readouts shifted by up to a few hundred ticks against the others
+    std::vector<std::pair<size_t, double>> MakeReadouts(size_t nReadouts)
+    {
+        std::mt19937 generator(1);
+        std::exponential_distribution<double> spacing(0.01);
+        std::uniform_real_distribution<double> skew(0.0, 300.0);
+        std::vector<double> times(kNTestModules, 0.0);
+        std::vector<std::pair<double, std::pair<size_t, double>>> sorted;
+        for (size_t i = 0; i < nReadouts; i++)
+        {
+            const size_t moduleID = generator() % kNTestModules;
+            times[moduleID] += spacing(generator);
+            sorted.push_back({times[moduleID] + skew(generator), {moduleID, times[moduleID]}});
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        std::vector<std::pair<size_t, double>> readouts;
+        for (const auto& [order, readout] : sorted)
+            readouts.push_back(readout);
+        return readouts;
+    }
+
+    // Every event built from the upstream entries, read in slices of sliceSize entries through blocks of the given capacity.
+    // An event is the upstream entry number of each module's readout, -1 for modules without one
+    std::multiset<std::vector<double>> BuildEvents(const TCAEventBuilder& builder, Long64_t sliceSize, size_t capacity)
+    {
+        std::multiset<std::vector<double>> events;
+        TCAEventBlock block(builder.GetColumnWidths(), capacity);
+        for (Long64_t first = 0; first < builder.GetEntries(); first += sliceSize)
+        {
+            const Long64_t last = std::min(first + sliceSize, builder.GetEntries());
+            size_t nEntries = 0;
+            for (Long64_t entry = first; (nEntries = builder.Read(block, entry, last)) > 0; entry += nEntries)
+            {
+                for (size_t i = 0; i < block.GetEntries(); i++)
+                {
+                    std::vector<double> event;
+                    for (size_t moduleID = 0; moduleID < kNTestModules; moduleID++)
+                    {
+                        const double entryNumber = block(i, moduleID, TCAEvent::kAmplitude);
+                        event.push_back(std::isnan(entryNumber) ? -1.0 : entryNumber);
+                    }
+                    events.insert(event);
+                }
+            }
+        }
+        return events;
+    }
+} // namespace
+
+int main()
+{
+    constexpr size_t nReadouts = 20000;
+    TCAEventBuilder builder(std::make_unique<TestSource>(MakeReadouts(nReadouts)), kWindow);
+
+    // Built in one go, every readout ends up in exactly one event
+    const auto events = BuildEvents(builder, builder.GetEntries(), 4096);
+    std::vector<size_t> uses(nReadouts, 0);
+    for (const auto& event : events)
+    {
+        for (double entryNumber : event)
+        {
+            if (entryNumber >= 0)
+                uses.at(static_cast<size_t>(entryNumber))++;
+        }
+    }
+    CATest::Check(std::all_of(uses.begin(), uses.end(), [](size_t n) { return n == 1; }), "every readout is built into exactly one event");
+    CATest::Check(events.size() < nReadouts, "coincident readouts are combined");
+
+    // Ranges built independently cut their boundaries alike, whatever the slicing and however often a block fills up
+    CATest::Check(BuildEvents(builder, 777, 4096) == events, "777-entry slices build the same events");
+    CATest::Check(BuildEvents(builder, 100, 4096) == events, "100-entry slices build the same events");
+    CATest::Check(BuildEvents(builder, 777, 16) == events, "777-entry slices through 16-event blocks build the same events");
+
+    return CATest::Result("TestEventBuilder");
+}
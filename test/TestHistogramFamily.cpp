@@ -0,0 +1,123 @@
+// Standard C++ includes
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "CATest.hpp"
+#include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+#include "TCAFlatHistogram.hpp"
+#include "TCAHistogram.hpp"
+#include "TCAHistogramFamily.hpp"
+#include "TCAHistogramOwner.hpp"
+
+namespace
+{
+    constexpr size_t kNEntries = 8;
+    constexpr size_t kWidth = 16;
+
+    typedef TCAHistogram<TCAFlatH1I> Member;
+
+    bool SameContents(const TCAFlatH1I& a, const TCAFlatH1I& b)
+    {
+        for (size_t bin = 0; bin < a.GetNcells(); bin++)
+        {
+            if (a.GetBinContent(bin) != b.GetBinContent(bin))
+                return false;
+        }
+        return a.GetEntries() == b.GetEntries();
+    }
+} // namespace
+
+int main()
+{
+    // Amplitudes of two modules, with empty channels as NaN and 0
+    std::array<size_t, TCAEventBlock::kNColumns> widths{};
+    widths[TCAEvent::GetColumn(0, TCAEvent::kAmplitude)] = kWidth;
+    widths[TCAEvent::GetColumn(1, TCAEvent::kAmplitude)] = kWidth;
+    TCAEventBlock block(widths, kNEntries);
+    block.SetRange(0, kNEntries);
+    double* module0 = block.GetMutableColumnData(TCAEvent::GetColumn(0, TCAEvent::kAmplitude));
+    double* module1 = block.GetMutableColumnData(TCAEvent::GetColumn(1, TCAEvent::kAmplitude));
+    for (size_t i = 0; i < kNEntries * kWidth; i++)
+    {
+        module0[i] = i % 3 == 0 ? NAN : (i % 50) * 10.0;
+        module1[i] = (i % 7) * 3.0;
+    }
+
+    // Members are added as the specification files add them, without fill functions of their own
+    TCAHistogramOwner owner("owner", "owner");
+    TCAHistogramFamily<TCAFlatH1I> family("family", "family", TCAEvent::kAmplitude);
+    std::vector<Member*> members;
+    for (const char* name : {"member0", "member1", "member2"})
+    {
+        members.push_back(owner.AddHistogram<Member>(name, name, 100, 0.0, 1000.0));
+        family.AddMember(members.back());
+    }
+    family.AddRow(0, 2, 0);
+    family.AddRow(0, 5, 1, 1.0, 2.0);
+    family.AddRow(1, 3, 2);
+    family.AddRow(1, 4, 2);
+
+    bool noFillers = true;
+    for (auto member : members)
+        noFillers &= !member->MakeFiller() && !member->MakeBlockFiller();
+    CATest::Check(noFillers, "family members have no fillers of their own");
+    for (bool readsBlocks : {true, false})
+    {
+        std::vector<TCAVirtualHistogram::Filler> fillers;
+        std::vector<TCAVirtualHistogram::BlockFiller> blockFillers;
+        owner.AppendFillers(fillers, blockFillers, nullptr, readsBlocks);
+        CATest::Check(fillers.empty() && blockFillers.empty(), readsBlocks ? "block sorts call nothing per member" : "event sorts call nothing per member");
+    }
+
+    // A histogram only filled per block is no event filler, so sorts entry by entry can warn that it stays empty
+    TCAHistogramOwner blockOwner("blockOwner", "blockOwner");
+    blockOwner.AddHistogram<Member>("blockOnly", "blockOnly", 100, 0.0, 1000.0)->SetBlockFillFunction([](std::shared_ptr<TCAFlatH1I>, const TCAEventBlock&) {});
+    std::vector<TCAVirtualHistogram::Filler> fillers;
+    std::vector<TCAVirtualHistogram::BlockFiller> blockFillers;
+    blockOwner.AppendFillers(fillers, blockFillers, nullptr, false);
+    CATest::Check(fillers.empty() && blockFillers.size() == 1, "a block-only histogram yields only a block filler");
+
+    // The family fills its members, per block and per event alike
+    family.MakeBlockFiller()(block);
+    auto filler = family.MakeFiller();
+    TCAEvent event(nullptr);
+    event.SetBlock(&block);
+    for (size_t entry = 0; entry < kNEntries; entry++)
+    {
+        event.SetBlockEntry(entry);
+        filler(&event);
+    }
+    event.SetBlock(nullptr);
+
+    std::vector<TCAFlatH1I> expected;
+    for (const char* name : {"expected0", "expected1", "expected2"})
+        expected.emplace_back(name, name, 100, 0.0, 1000.0);
+    for (size_t pass = 0; pass < 2; pass++)
+    {
+        for (size_t entry = 0; entry < kNEntries; entry++)
+        {
+            const double* values0 = module0 + entry * kWidth;
+            const double* values1 = module1 + entry * kWidth;
+            if (values0[2] > 0)
+                expected[0].Fill(values0[2]);
+            if (values0[5] > 0)
+                expected[1].Fill(2.0 * values0[5] + 1.0);
+            for (size_t ch : {3, 4})
+            {
+                if (values1[ch] > 0)
+                    expected[2].Fill(values1[ch]);
+            }
+        }
+    }
+    bool sameContents = true;
+    for (size_t i = 0; i < members.size(); i++)
+        sameContents &= SameContents(*members[i]->Merge(), expected[i]);
+    CATest::Check(sameContents, "the family fills each member from its rows");
+
+    return CATest::Result("TestHistogramFamily");
+}
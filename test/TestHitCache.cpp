@@ -0,0 +1,180 @@
+// Standard C++ includes
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "CATest.hpp"
+#include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+#include "TCAHitCache.hpp"
+
+namespace
+{
+    constexpr size_t kNEntries = 15;
+
+    size_t Column(size_t moduleID, TCAEvent::FilterID filterID) { return TCAEvent::GetColumn(moduleID, filterID); }
+
+    // Columns of a run with an SCP module, an SCP module with amplitudes only, a QDC module and a module that is not read
+    std::array<size_t, TCAEventBlock::kNColumns> GetWidths()
+    {
+        std::array<size_t, TCAEventBlock::kNColumns> widths{};
+        widths[Column(0, TCAEvent::kAmplitude)] = 16;
+        widths[Column(0, TCAEvent::kChannelTime)] = 16;
+        widths[Column(0, TCAEvent::kPileUp)] = 16;
+        widths[Column(0, TCAEvent::kModuleTime)] = 1;
+        widths[Column(0, TCAEvent::kTriggerTime)] = 2;
+        widths[Column(1, TCAEvent::kAmplitude)] = 16;
+        widths[Column(1, TCAEvent::kModuleTime)] = 1;
+        widths[Column(2, TCAEvent::kIntLong)] = 16;
+        return widths;
+    }
+
+    // Value of an entry as written, with gaps of NaN, a dither below one on the amplitudes, negative channel times and
+    // module timestamps that sometimes step back
+    double GetWritten(size_t entry, size_t column, size_t idx)
+    {
+        if ((entry * 7 + column + idx) % 5 == 0)
+            return std::numeric_limits<double>::quiet_NaN();
+        switch (column % TCAEvent::kNFilters)
+        {
+        case TCAEvent::kAmplitude:
+            return 100.0 * entry + idx + 0.25;
+        case TCAEvent::kChannelTime:
+            return -1.0 * (entry + idx);
+        case TCAEvent::kPileUp:
+            return (entry + idx) % 3 == 0 ? 1.0 : 0.0;
+        case TCAEvent::kModuleTime:
+            return 1e12 + 1000.0 * entry - (entry % 4 == 3 ? 5000.0 : 0.0);
+        default:
+            return 10.0 * entry + idx + column;
+        }
+    }
+
+    // As read back: integers, the dither dropped
+    double GetExpected(size_t entry, size_t column, size_t idx)
+    {
+        return std::floor(GetWritten(entry, column, idx));
+    }
+
+    bool Same(double a, double b) { return (std::isnan(a) && std::isnan(b)) || a == b; }
+
+    // Every value of the present columns of the block against GetExpected(), for the entries it was read from
+    bool ReadsBack(const TCAEventBlock& block, size_t firstEntry)
+    {
+        for (size_t row = 0; row < block.GetEntries(); row++)
+        {
+            for (size_t column = 0; column < TCAEventBlock::kNColumns; column++)
+            {
+                const double* data = block.GetColumnData(column);
+                const size_t width = block.GetColumnWidth(column);
+                for (size_t idx = 0; data != nullptr && idx < width; idx++)
+                {
+                    if (!Same(data[row * width + idx], GetExpected(firstEntry + row, column, idx)))
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
+} // namespace
+
+int main()
+{
+    const std::string fileName = (std::filesystem::temp_directory_path() / "TestHitCache.cahc").string();
+    const auto widths = GetWidths();
+
+    // Compression round trip of the raw buffers the cache is made of
+    std::vector<unsigned char> raw(100000), compressed, decompressed;
+    for (size_t i = 0; i < raw.size(); i++)
+        raw[i] = static_cast<unsigned char>(i % 7 == 0 ? i / 7 : 0);
+    const bool isCompressed = CAHitCache::Compress(raw, compressed, ROOT::RCompressionSetting::EAlgorithm::kZSTD, TCAHitCacheWriter::kDefaultLevel);
+    CATest::Check(isCompressed && compressed.size() < raw.size(), "repetitive data compress");
+    if (isCompressed)
+    {
+        decompressed.resize(raw.size());
+        CAHitCache::Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+        CATest::Check(decompressed == raw, "compressed data decompress to the original");
+    }
+
+    // Blocks of 5, 3 and 7 entries, arriving out of order as the sort threads hand them in
+    {
+        TCAHitCacheWriter writer(fileName, "/data/run042.root");
+        TCAEventBlock block(widths, 7);
+        for (const auto& [first, last] : {std::pair<size_t, size_t>{8, 15}, {0, 5}, {5, 8}})
+        {
+            block.SetRange(first, last);
+            for (size_t column = 0; column < TCAEventBlock::kNColumns; column++)
+            {
+                double* data = block.GetMutableColumnData(column);
+                for (size_t row = 0; data != nullptr && row < block.GetEntries(); row++)
+                {
+                    for (size_t idx = 0; idx < widths[column]; idx++)
+                        data[row * widths[column] + idx] = GetWritten(first + row, column, idx);
+                }
+            }
+            writer.WriteBlock(block);
+        }
+        writer.Close();
+    }
+
+    {
+        TCAHitCacheReader reader(fileName);
+        CATest::Check(reader.GetEntries() == kNEntries && reader.GetBlockCount() == 3, "every block is indexed");
+        CATest::Check(reader.GetNaturalBlockSize() == 7, "the largest block sets the natural block size");
+        CATest::Check(std::string(reader.GetSourceName()) == "run042.root", "the cache names the run it was made from");
+        CATest::Check(reader.GetColumnWidths() == widths, "the cache keeps the column layout");
+
+        // Whole blocks, then a read from the middle of the first stored block into the last, then short reads at every offset
+        TCAEventBlock all(widths, kNEntries);
+        reader.Read(all, 0, kNEntries);
+        CATest::Check(ReadsBack(all, 0), "all entries read back");
+
+        TCAEventBlock spanning(widths, 16);
+        CATest::Check(reader.Read(spanning, 3, 12) == 9 && ReadsBack(spanning, 3), "a read across stored blocks skips into the first and stops inside the last");
+
+        bool shortReads = true;
+        TCAEventBlock small(widths, 2);
+        for (size_t first = 0; first < kNEntries; first++)
+            shortReads &= reader.Read(small, first, kNEntries) == std::min<size_t>(2, kNEntries - first) && ReadsBack(small, first);
+        CATest::Check(shortReads, "reads of two entries from every offset read back");
+
+        // Pruned columns are stored but left out of the block, the columns after them still decode
+        auto pruned = widths;
+        pruned[Column(0, TCAEvent::kChannelTime)] = 0;
+        pruned[Column(1, TCAEvent::kAmplitude)] = 0;
+        TCAEventBlock prunedBlock(pruned, 16);
+        reader.Read(prunedBlock, 2, 13);
+        CATest::Check(prunedBlock.GetColumnData(Column(1, TCAEvent::kAmplitude)) == nullptr && ReadsBack(prunedBlock, 2), "columns after pruned ones read back");
+    }
+
+    // A cache that was never closed is removed rather than left to look valid
+    {
+        TCAHitCacheWriter writer(fileName, "/data/run042.root");
+        TCAEventBlock block(widths, 7);
+        block.SetRange(0, 5);
+        writer.WriteBlock(block);
+    }
+    bool thrown = false;
+    try
+    {
+        TCAHitCacheReader unclosed(fileName);
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    CATest::Check(thrown, "an unclosed cache is not read");
+    std::remove(fileName.c_str());
+
+    return CATest::Result("TestHitCache");
+}
@@ -0,0 +1,154 @@
+// Standard C++ includes
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "CAConfiguration.hpp"
+#include "CATest.hpp"
+#include "TCAEvent.hpp"
+#include "TCAEventBlock.hpp"
+#include "TCAListfileReader.hpp"
+
+namespace
+{
+    typedef TCAListfileReader Reader;
+
+    constexpr size_t kNEvents = 3;
+
+    uint32_t Section(Reader::SectionType type, size_t size, uint32_t eventIndex = 0)
+    {
+        return static_cast<uint32_t>(type) << Reader::kSectionTypeShift | eventIndex << Reader::kEventIndexShift | static_cast<uint32_t>(size);
+    }
+    uint32_t Data(uint32_t address, uint32_t value, bool pileUp = false)
+    {
+        return Reader::kDataWord | address << Reader::kAddressShift | (pileUp ? Reader::kPileUpBit : 0) | value;
+    }
+
+    // One readout of an MDPP-16: header, data words, extended timestamp, end of event, end marker
+    void AddReadout(std::vector<uint32_t>& section, uint32_t moduleType, const std::vector<uint32_t>& data, uint64_t timestamp)
+    {
+        std::vector<uint32_t> words = {Reader::kHeaderWord};
+        words.insert(words.end(), data.begin(), data.end());
+        words.push_back(Reader::kExtendedTimestampWord | static_cast<uint32_t>(timestamp >> 30));
+        words.push_back(Reader::kEndOfEventWord | static_cast<uint32_t>(timestamp & Reader::kTimestampMask));
+        words.push_back(Reader::kEndMarker);
+        section.push_back(moduleType << Reader::kModuleTypeShift | static_cast<uint32_t>(words.size()));
+        section.insert(section.end(), words.begin(), words.end());
+    }
+
+    uint64_t GetTimestamp(size_t event) { return (uint64_t(5) << 30) + 1000 * event; }
+
+    // Listfile of kNEvents events of the configured modules, interleaved with a config section, timeticks and events of
+    // another VME event. badModule, if set, is read out with the other firmware's type byte
+    std::vector<uint32_t> MakeListfile(int badModule = -1)
+    {
+        uint32_t magic;
+        std::memcpy(&magic, "MVME", sizeof(magic));
+        std::vector<uint32_t> words = {magic, Reader::kVersion};
+        words.push_back(Section(Reader::kConfigSection, 2));
+        words.insert(words.end(), {0x12345678, 0x9abcdef0});
+
+        for (size_t event = 0; event < kNEvents; event++)
+        {
+            std::vector<uint32_t> section;
+            for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+            {
+                const bool isQDC = std::strcmp(kModuleTypes[moduleID], "MDPP16QDC") == 0;
+                uint32_t type = isQDC ? Reader::kMDPP16QDCType : Reader::kMDPP16SCPType;
+                if (static_cast<int>(moduleID) == badModule)
+                    type = isQDC ? Reader::kMDPP16SCPType : Reader::kMDPP16QDCType;
+
+                std::vector<uint32_t> data;
+                if (isQDC)
+                    data = {Data(5, 300 + event), Data(48 + 5, 30 + event)};
+                else if (moduleID == 0)
+                    data = {Data(3, 1000 + event, event % 2 == 1), Data(16 + 3, 555), Data(32, 7 + event), Data(33, 9)};
+                else if (event != 1)
+                    data = {Data(0, 7)}; // No hits in the second event
+                AddReadout(section, type, data, GetTimestamp(event) + moduleID);
+            }
+            section.push_back(Reader::kEndMarker);
+            words.push_back(Section(Reader::kEventSection, section.size()));
+            words.insert(words.end(), section.begin(), section.end());
+
+            // Sections the reader skips
+            words.push_back(Section(Reader::kTimetickSection, 0));
+            words.push_back(Section(Reader::kEventSection, 1, 1));
+            words.push_back(Reader::kEndMarker);
+        }
+        words.push_back(Section(Reader::kEndOfFileSection, 0));
+        return words;
+    }
+
+    void WriteListfile(const std::string& fileName, const std::vector<uint32_t>& words)
+    {
+        FILE* file = fopen(fileName.c_str(), "wb");
+        if (file == nullptr || fwrite(words.data(), sizeof(uint32_t), words.size(), file) != words.size())
+        {
+            throw std::runtime_error("[ERROR] Could not write test listfile " + fileName);
+        }
+        fclose(file);
+    }
+} // namespace
+
+int main()
+{
+    const std::string fileName = (std::filesystem::temp_directory_path() / ("TestListfileReader" LISTFILE_EXTENSION)).string();
+    CATest::Check(Reader::IsListfile(fileName) && !Reader::IsListfile("run042.root"), "listfiles are told apart by their extension");
+
+    WriteListfile(fileName, MakeListfile());
+    {
+        Reader reader(fileName);
+        CATest::Check(reader.GetEntries() == kNEvents, "only the events of the sorted VME event are indexed");
+
+        // Two events from the middle, through a block that takes them all
+        TCAEventBlock block(reader.GetColumnWidths(), 2);
+        CATest::Check(reader.Read(block, 1, kNEvents) == 2, "a range is read to its end");
+        bool sameValues = true;
+        for (size_t row = 0; row < block.GetEntries(); row++)
+        {
+            const size_t event = 1 + row;
+            sameValues &= block(row, 0, TCAEvent::kAmplitude, 3) == 1000 + event;
+            sameValues &= block(row, 0, TCAEvent::kPileUp, 3) == (event % 2 == 1 ? 1.0 : 0.0);
+            sameValues &= block(row, 0, TCAEvent::kChannelTime, 3) == 555;
+            sameValues &= block(row, 0, TCAEvent::kTriggerTime, 0) == 7 + event && block(row, 0, TCAEvent::kTriggerTime, 1) == 9;
+            sameValues &= std::isnan(block(row, 0, TCAEvent::kAmplitude, 4)) && std::isnan(block(row, 0, TCAEvent::kPileUp, 4));
+            for (size_t moduleID = 0; moduleID < TCAEvent::kNModules; moduleID++)
+                sameValues &= block(row, moduleID, TCAEvent::kModuleTime) == GetTimestamp(event) + moduleID;
+            for (size_t moduleID = 1; moduleID < TCAEvent::kNModules; moduleID++)
+            {
+                if (std::strcmp(kModuleTypes[moduleID], "MDPP16QDC") == 0)
+                    sameValues &= block(row, moduleID, TCAEvent::kIntLong, 5) == 300 + event && block(row, moduleID, TCAEvent::kIntShort, 5) == 30 + event;
+                else
+                    sameValues &= event == 1 ? std::isnan(block(row, moduleID, TCAEvent::kAmplitude, 0)) : block(row, moduleID, TCAEvent::kAmplitude, 0) == 7;
+            }
+        }
+        CATest::Check(sameValues, "hits, pile-up flags and timestamps decode into their columns");
+    }
+
+    // A module read out with the other firmware means the listfile was taken with another setup
+    WriteListfile(fileName, MakeListfile(1));
+    bool thrown = false;
+    try
+    {
+        Reader reader(fileName);
+        TCAEventBlock block(reader.GetColumnWidths(), 1);
+        reader.Read(block, 0, 1);
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    CATest::Check(thrown, "a module of the wrong type is not decoded");
+    std::remove(fileName.c_str());
+
+    return CATest::Result("TestListfileReader");
+}
@@ -0,0 +1,140 @@
+// Standard C++ includes
+#include <algorithm>
+#include <array>
+#include <map>
+#include <random>
+#include <vector>
+
+// ROOT includes
+
+// Project includes
+#include "CAAddBack.hpp"
+#include "CATest.hpp"
+#include "TCAFillBuffer.hpp"
+#include "TCAFlatHistogram.hpp"
+#include "TCASymmetricHistogram.hpp"
+
+namespace
+{
+    constexpr int kNBins = 100;
+    constexpr double kMax = 1000.0;
+
+    inline double Center(int channel) { return (channel + 0.5) * (kMax / kNBins); }
+
+    // Unfolded matrix against a flat one filled with both orders of every pair, bins 1 to kNBins
+    template <typename S>
+    bool SameContents(const TCASymmetricH2<S>& matrix, const TCAFlatH2I& reference)
+    {
+        for (size_t binY = 1; binY <= kNBins; binY++)
+        {
+            for (size_t binX = 1; binX <= kNBins; binX++)
+            {
+                if (matrix.GetBinContent(binX, binY) != reference.GetBinContent(binX, binY))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // Triples of channels, sorted, and how often they were filled
+    typedef std::map<std::array<int, 3>, uint32_t> Triples;
+
+    bool SameContents(const TCASymmetricH3I& cube, const Triples& reference)
+    {
+        uint64_t nTriples = 0;
+        for (const auto& [triple, count] : reference)
+        {
+            // Any order of the three bins reads the same cell
+            if (cube.GetBinContent(triple[2] + 1, triple[0] + 1, triple[1] + 1) != count)
+                return false;
+            nTriples += count;
+        }
+        return cube.GetEntries() == nTriples;
+    }
+} // namespace
+
+int main()
+{
+    std::mt19937 generator(1);
+    std::uniform_real_distribution<double> energy(-50.0, kMax + 50.0); // Some gammas off the axis
+    std::uniform_int_distribution<size_t> multiplicity(0, 6);
+
+    TCASymmetricH2I matrix("matrix", "matrix", kNBins, 0.0, kMax);
+    TCASymmetricH2I buffered(matrix);
+    TCASymmetricH3I cube("cube", "cube", kNBins, 0.0, kMax);
+    TCASymmetricH3I bufferedCube(cube);
+    TCAFillBuffer buffer(64);
+    buffered.SetFillBuffer(&buffer);
+    bufferedCube.SetFillBuffer(&buffer);
+
+    // Brute force: every ordered pair of distinct gammas, every sorted triple
+    TCAFlatH2I pairs("pairs", "pairs", kNBins, 0.0, kMax, kNBins, 0.0, kMax);
+    TCAFlatH2I projectedPairs("projectedPairs", "projectedPairs", kNBins, 0.0, kMax, kNBins, 0.0, kMax);
+    Triples triples;
+    for (size_t event = 0; event < 20000; event++)
+    {
+        std::vector<double> energies(multiplicity(generator));
+        for (auto& e : energies)
+            e = energy(generator);
+        matrix.FillCoincidences(energies.data(), energies.size());
+        buffered.FillCoincidences(energies.data(), energies.size());
+        cube.FillCoincidences(energies.data(), energies.size());
+        bufferedCube.FillCoincidences(energies.data(), energies.size());
+
+        std::vector<int> channels;
+        for (double e : energies)
+        {
+            if (e >= 0.0 && e < kMax)
+                channels.push_back(static_cast<int>(e / (kMax / kNBins)));
+        }
+        for (size_t i = 0; i < channels.size(); i++)
+        {
+            for (size_t j = 0; j < channels.size(); j++)
+            {
+                if (i != j)
+                    pairs.Fill(Center(channels[i]), Center(channels[j]));
+            }
+        }
+        for (size_t i = 0; i < channels.size(); i++)
+        {
+            for (size_t j = i + 1; j < channels.size(); j++)
+            {
+                for (size_t k = j + 1; k < channels.size(); k++)
+                {
+                    std::array<int, 3> triple = {channels[i], channels[j], channels[k]};
+                    std::sort(triple.begin(), triple.end());
+                    triples[triple]++;
+                    for (const auto& [x, y] : {std::pair{triple[0], triple[1]}, {triple[0], triple[2]}, {triple[1], triple[2]}})
+                    {
+                        projectedPairs.Fill(Center(x), Center(y));
+                        projectedPairs.Fill(Center(y), Center(x));
+                    }
+                }
+            }
+        }
+    }
+    buffer.Flush();
+
+    CATest::Check(SameContents(matrix, pairs), "matrix unfolds to every ordered pair");
+    CATest::Check(2 * matrix.GetEntries() == pairs.GetEntries(), "matrix counts every unordered pair once");
+    CATest::Check(SameContents(buffered, pairs) && buffered.GetEntries() == matrix.GetEntries(), "buffered matrix fills the same pairs");
+    CATest::Check(SameContents(cube, triples), "cube holds every sorted triple");
+    CATest::Check(SameContents(bufferedCube, triples) && buffer.GetTargetCount() == 1, "cube given a fill buffer fills the same triples directly");
+    CATest::Check(SameContents(*cube.Project(), projectedPairs), "cube projects to the pairs of its triples");
+
+    TCASymmetricH2I merged(matrix);
+    merged.Add(&buffered);
+    CATest::Check(merged.GetBinContent(5, 7) == 2 * matrix.GetBinContent(5, 7) && merged.GetEntries() == 2 * matrix.GetEntries(), "matrices add bin by bin");
+    TCASymmetricH3I mergedCube(cube);
+    mergedCube.Add(&bufferedCube);
+    CATest::Check(mergedCube.GetEntries() == 2 * cube.GetEntries() && mergedCube.GetBrickCount() == cube.GetBrickCount(), "cubes add brick by brick");
+
+    // Three clovers: one crystal, two crystals in time adding back to the same energy, and one that did not fire
+    TCASymmetricH2I addBack("addBack", "addBack", kNBins, 0.0, kMax);
+    const std::vector<std::array<double, 4>> cloverE = {{505.0, 0.0, 0.0, 0.0}, {205.0, 300.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 0.0}};
+    const std::vector<std::array<double, 4>> cloverT = {{0.0, 0.0, 0.0, 0.0}, {0.0, 10.0, 0.0, 0.0}, {0.0, 0.0, 0.0, 0.0}};
+    CAAddBack::FillCoincidences(addBack, cloverE, cloverT);
+    CATest::Check(addBack.GetEntries() == 1 && addBack.GetBinContent(51, 51) == 2, "add-back energies of two clovers fill one pair");
+
+    return CATest::Result("TestSymmetricHistogram");
+}
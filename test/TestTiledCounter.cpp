@@ -0,0 +1,120 @@
+// Standard C++ includes
+#include <cstdint>
+#include <random>
+
+// ROOT includes
+
+// Project includes
+#include "CATest.hpp"
+#include "TCAFillBuffer.hpp"
+#include "TCATiledHistogram.hpp"
+
+namespace
+{
+    constexpr int kNBins = 1000;
+    constexpr double kMax = 1000.0;
+
+    typedef TCATiledH2<uint64_t> Reference;
+
+    template <typename H>
+    H Make(const char* name)
+    {
+        return H(name, name, kNBins, 0.0, kMax, kNBins, 0.0, kMax);
+    }
+
+    // Every cell, under- and overflow included, and the entries
+    bool SameContents(const TCATiledH2C& counts, const Reference& reference)
+    {
+        for (int binY = 0; binY < kNBins + 2; binY++)
+        {
+            for (int binX = 0; binX < kNBins + 2; binX++)
+            {
+                if (counts.GetBinContent(binX, binY) != reference.GetBinContent(binX, binY))
+                    return false;
+            }
+        }
+        return counts.GetEntries() == reference.GetEntries();
+    }
+
+    // Bytes of the tiles alone, at the given counter width for every tile
+    size_t GetTileBytes(const TCATiledH2C& counts, size_t width)
+    {
+        return counts.GetTileCount() * TCATiledH2C::kTileCells * width;
+    }
+} // namespace
+
+int main()
+{
+    std::mt19937 generator(3);
+    std::uniform_real_distribution<double> anywhere(-10.0, kMax + 10.0);
+    auto counts = Make<TCATiledH2C>("counts");
+    auto reference = Make<Reference>("reference");
+    const size_t indexBytes = counts.GetAllocatedBytes();
+
+    // Spread thinly, every tile stays at 16 bits
+    for (size_t i = 0; i < 200000; i++)
+    {
+        const double x = anywhere(generator), y = anywhere(generator);
+        counts.Fill(x, y);
+        reference.Fill(x, y);
+    }
+    CATest::Check(SameContents(counts, reference), "16-bit counters count as 64-bit bins");
+    CATest::Check(counts.GetAllocatedBytes() == indexBytes + GetTileBytes(counts, 2), "thinly filled tiles stay at 16 bits");
+
+    // One bin past 16 bits widens its tile alone
+    for (size_t i = 0; i < 70000; i++)
+    {
+        counts.Fill(5.5, 5.5);
+        reference.Fill(5.5, 5.5);
+    }
+    CATest::Check(SameContents(counts, reference), "a counter filled past 16 bits keeps counting");
+    CATest::Check(counts.GetAllocatedBytes() == indexBytes + GetTileBytes(counts, 2) + TCATiledH2C::kTileCells * 2, "only the tile of the full counter is widened to 32 bits");
+
+    // Two 16-bit replicas whose sum overflows 16 bits half way through a tile
+    auto first = Make<TCATiledH2C>("first");
+    auto second = Make<TCATiledH2C>("second");
+    for (size_t i = 0; i < 40000; i++)
+    {
+        first.Fill(1.5, 1.5);
+        second.Fill(1.5, 1.5);
+        second.Fill(2.5, 2.5);
+    }
+    first.Add(&second);
+    CATest::Check(first.GetBinContent(2, 2) == 80000 && first.GetBinContent(3, 3) == 40000 && first.GetEntries() == 120000, "16-bit replicas overflowing on merge add up");
+
+    // Merged with a buffered replica, and with replicas merged into themselves until they pass 32 bits
+    auto buffered = Make<TCATiledH2C>("buffered");
+    TCAFillBuffer buffer(1000);
+    buffered.SetFillBuffer(&buffer);
+    for (size_t i = 0; i < 70000; i++)
+    {
+        buffered.Fill(5.5, 5.5);
+        buffered.Fill(700.2, 300.1);
+        reference.Fill(5.5, 5.5);
+        reference.Fill(700.2, 300.1);
+    }
+    buffer.Flush();
+    counts.Add(&buffered);
+    CATest::Check(SameContents(counts, reference), "buffered fills past 16 bits merge");
+
+    auto doubled = Make<TCATiledH2C>("doubled");
+    auto doubledReference = Make<Reference>("doubledReference");
+    for (size_t i = 0; i < 70000; i++)
+    {
+        doubled.Fill(900.5, 900.5);
+        doubledReference.Fill(900.5, 900.5);
+    }
+    for (size_t i = 0; i < 16; i++) // 70000 * 2^16 counts, past 32 bits
+    {
+        TCATiledH2C copy(doubled);
+        doubled.Add(&copy);
+        Reference copyReference(doubledReference);
+        doubledReference.Add(&copyReference);
+    }
+    CATest::Check(doubled.GetBinContent(901, 901) == uint64_t(70000) << 16, "counters merged past 32 bits keep counting");
+    counts.Add(&doubled);
+    reference.Add(&doubledReference);
+    CATest::Check(SameContents(counts, reference), "64-bit counters merge with narrower ones");
+
+    return CATest::Result("TestTiledCounter");
+}
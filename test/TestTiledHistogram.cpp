@@ -0,0 +1,116 @@
+// Standard C++ includes
+#include <array>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+// ROOT includes
+
+// Project includes
+#include "CACrosstalkCorrection.hpp"
+#include "CATest.hpp"
+#include "TCAFillBuffer.hpp"
+#include "TCAFlatHistogram.hpp"
+#include "TCATiledHistogram.hpp"
+
+namespace
+{
+    constexpr int kNBins = 4096;
+    constexpr double kMax = 4096.0;
+
+    // Every cell, under- and overflow included, and the entries
+    template <typename A, typename B>
+    bool SameContents(const A& a, const B& b)
+    {
+        for (int binY = 0; binY < a.GetNbinsY() + 2; binY++)
+        {
+            for (int binX = 0; binX < a.GetNbinsX() + 2; binX++)
+            {
+                if (a.GetBinContent(binX, binY) != b.GetBinContent(binX, binY))
+                    return false;
+            }
+        }
+        return a.GetEntries() == b.GetEntries();
+    }
+} // namespace
+
+int main()
+{
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<double> peak(-5.0, 300.0); // Clusters a few tiles wide, running into the underflow
+    std::uniform_real_distribution<double> anywhere(-100.0, kMax + 100.0);
+
+    // The fills split over two replicas, one direct and one buffered, as the sort threads would fill them
+    TCAFlatH2I flat("flat", "flat", kNBins, 0.0, kMax, kNBins, 0.0, kMax);
+    TCATiledH2I tiled("tiled", "tiled", kNBins, 0.0, kMax, kNBins, 0.0, kMax);
+    TCATiledH2I direct(tiled);
+    TCATiledH2I buffered(tiled);
+    TCAFillBuffer buffer(100);
+    buffered.SetFillBuffer(&buffer);
+    for (size_t i = 0; i < 200000; i++)
+    {
+        const double x = i % 1000 == 0 ? anywhere(generator) : peak(generator) + 1000.0 * (i % 2);
+        const double y = i % 1000 == 0 ? anywhere(generator) : peak(generator) + 2000.0;
+        flat.Fill(x, y);
+        tiled.Fill(x, y);
+        (i % 3 == 0 ? buffered : direct).Fill(x, y);
+    }
+    buffer.Flush();
+    CATest::Check(SameContents(tiled, flat), "tiled and flat histograms have the same contents");
+    CATest::Check(tiled.GetTileCount() < tiled.GetNcells() / TCATiledH2I::kTileCells / 4, "only tiles that were filled are allocated");
+
+    direct.Add(&buffered);
+    CATest::Check(SameContents(direct, flat), "direct and buffered replicas merge to the flat histogram");
+
+    TCATiledH2I other("other", "other", kNBins, 0.0, kMax, kNBins / 2, 0.0, kMax);
+    bool thrown = false;
+    try
+    {
+        direct.Add(&other);
+    }
+    catch (const std::runtime_error&)
+    {
+        thrown = true;
+    }
+    CATest::Check(thrown, "histograms of different binning are not added");
+
+    // The crosstalk matrices of one clover, filled from the same crystals into both kinds of matrix
+    std::array<std::shared_ptr<TCAFlatH2I>, 6> flatPairs;
+    std::array<std::shared_ptr<TCATiledH2I>, 6> tiledPairs;
+    for (size_t pair = 0; pair < flatPairs.size(); pair++)
+    {
+        flatPairs[pair] = std::make_shared<TCAFlatH2I>("flat_pair", "flat_pair", kNBins, 0.0, kMax, kNBins, 0.0, kMax);
+        tiledPairs[pair] = std::make_shared<TCATiledH2I>("tiled_pair", "tiled_pair", kNBins, 0.0, kMax, kNBins, 0.0, kMax);
+    }
+    std::uniform_real_distribution<double> energy(0.0, 3000.0);
+    std::uniform_real_distribution<double> time(0.0, 400.0);
+    size_t nPairs = 0;
+    for (size_t i = 0; i < 50000; i++)
+    {
+        std::array<double, 4> xtalE, xtalT;
+        for (size_t xtal = 0; xtal < 4; xtal++)
+        {
+            xtalE[xtal] = energy(generator);
+            xtalT[xtal] = time(generator);
+        }
+        for (size_t x = 0; x < 4; x++)
+        {
+            for (size_t y = x + 1; y < 4; y++)
+                nPairs += xtalE[x] > CAAddBack::kAddBackThreshold && xtalE[y] > CAAddBack::kAddBackThreshold && std::fabs(xtalT[x] - xtalT[y]) < CAAddBack::kAddBackWindow;
+        }
+        CACrosstalkCorrection::FillXTalkHistograms(flatPairs, xtalE, xtalT);
+        CACrosstalkCorrection::FillXTalkHistograms(tiledPairs, xtalE, xtalT);
+    }
+    bool samePairs = true;
+    size_t nFilled = 0;
+    for (size_t pair = 0; pair < flatPairs.size(); pair++)
+    {
+        samePairs &= SameContents(*tiledPairs[pair], *flatPairs[pair]);
+        nFilled += tiledPairs[pair]->GetEntries();
+    }
+    CATest::Check(samePairs, "tiled and flat crosstalk matrices have the same contents");
+    CATest::Check(nFilled == nPairs, "every crystal pair above threshold and in time is filled once");
+
+    return CATest::Result("TestTiledHistogram");
+}